@@ -0,0 +1,21 @@
+# The FAT16 volume presented to the instrument, formatted at build time by host/gen_disk.py.
+# Included by msc/CMakeLists.txt for the firmware and by host/CMakeLists.txt for scsi_replay, so that a recording is
+# replayed against the same volume. The defaults reproduce the flash drive the original sectors were copied from.
+set(DISK_IMAGE_ARGS
+    --sectors 65536
+    --cluster-sectors 4
+    --label STANDARD
+    --serial 0x47310b47
+    --dir logger
+    --dir-cluster 3
+    --hidden-sectors 2048
+)
+set(DISK_IMAGE_DIR ${CMAKE_CURRENT_BINARY_DIR}/disk_image)
+
+find_package(Python3 REQUIRED COMPONENTS Interpreter)
+add_custom_command(
+    OUTPUT ${DISK_IMAGE_DIR}/disk_geometry.h ${DISK_IMAGE_DIR}/disk_image_data.h
+    COMMAND ${Python3_EXECUTABLE} ${CMAKE_CURRENT_LIST_DIR}/../host/gen_disk.py ${DISK_IMAGE_ARGS} ${DISK_IMAGE_DIR}
+    DEPENDS ${CMAKE_CURRENT_LIST_DIR}/../host/gen_disk.py
+    COMMENT "Formatting the disk image"
+)
@@ -0,0 +1,28 @@
+#ifndef HOT_PATH_H_
+#define HOT_PATH_H_
+
+// Placement of the hot paths
+// Code runs from flash through the XIP cache, and a cache miss stalls the core while the line is fetched over QSPI.
+// The functions that run for every USB sector or received byte, and the small tables they read, are copied to SRAM
+// at boot instead, so their timing doesn't depend on what else has been through the cache.
+//
+//   int32_t HOT_FUNC(tud_msc_read10_cb)(uint8_t lun, ...)
+//   static const uint8_t HOT_DATA("disk_image") table[] = {...};
+//
+// Build with HOT_IN_RAM=0 to leave everything in flash, e.g. to compare the callback timings. On the host the
+// macros do nothing, so the same sources build for the host tools.
+
+#ifndef HOT_IN_RAM
+#define HOT_IN_RAM 1
+#endif
+
+#if HOT_IN_RAM && defined(PICO_ON_DEVICE) && PICO_ON_DEVICE
+#include "pico.h"
+#define HOT_FUNC(name) __not_in_flash_func(name)
+#define HOT_DATA(group) __not_in_flash(group)
+#else
+#define HOT_FUNC(name) name
+#define HOT_DATA(group)
+#endif
+
+#endif /* HOT_PATH_H_ */
@@ -0,0 +1,233 @@
+#include <stdio.h>
+
+#include "pico/stdlib.h"
+#include "hardware/sync.h"
+#include "sched.h"
+
+typedef struct
+{
+  char const *name;
+  sched_fn_t fn;
+  uint32_t due_ms;
+  bool queued; // in the deadline heap
+  uint32_t runs;
+  uint32_t max_us;
+  uint64_t busy_us;
+} sched_task_t;
+
+static sched_task_t tasks[SCHED_MAX_TASKS];
+static int task_count = 0;
+
+// Min-heap of task ids, ordered by deadline
+static uint8_t heap[SCHED_MAX_TASKS];
+static int heap_size = 0;
+
+static volatile uint32_t wake_mask = 0; // tasks woken by sched_wake(), set from interrupts
+static uint64_t stats_start_us = 0;
+
+static uint32_t now_ms(void)
+{
+  return (uint32_t)(time_us_64() / 1000);
+}
+
+// Deadline comparison that survives the ms counter wrapping
+static bool due_before(int a, int b)
+{
+  return (int32_t)(tasks[a].due_ms - tasks[b].due_ms) < 0;
+}
+
+//--------------------------------------------------------------------+
+// Deadline heap
+//--------------------------------------------------------------------+
+
+static void heap_swap(int i, int j)
+{
+  uint8_t t = heap[i];
+  heap[i] = heap[j];
+  heap[j] = t;
+}
+
+static void sift_up(int i)
+{
+  while (i > 0 && due_before(heap[i], heap[(i - 1) / 2]))
+  {
+    heap_swap(i, (i - 1) / 2);
+    i = (i - 1) / 2;
+  }
+}
+
+static void sift_down(int i)
+{
+  while (1)
+  {
+    int smallest = i;
+    int l = 2 * i + 1;
+    int r = l + 1;
+    if (l < heap_size && due_before(heap[l], heap[smallest]))
+      smallest = l;
+    if (r < heap_size && due_before(heap[r], heap[smallest]))
+      smallest = r;
+    if (smallest == i)
+      return;
+    heap_swap(i, smallest);
+    i = smallest;
+  }
+}
+
+static void heap_push(int id)
+{
+  heap[heap_size] = (uint8_t)id;
+  sift_up(heap_size++);
+  tasks[id].queued = true;
+}
+
+static void heap_remove_at(int i)
+{
+  tasks[heap[i]].queued = false;
+  heap[i] = heap[--heap_size];
+  if (i < heap_size)
+  {
+    sift_down(i);
+    sift_up(i);
+  }
+}
+
+// Schedule a task at a new deadline, whether or not it is queued already
+static void schedule(int id, uint32_t due_ms)
+{
+  if (tasks[id].queued)
+  {
+    for (int i = 0; i < heap_size; i++)
+    {
+      if (heap[i] == id)
+      {
+        heap_remove_at(i);
+        break;
+      }
+    }
+  }
+  tasks[id].due_ms = due_ms;
+  heap_push(id);
+}
+
+static void take_wakeups(void)
+{
+  uint32_t status = save_and_disable_interrupts();
+  uint32_t mask = wake_mask;
+  wake_mask = 0;
+  restore_interrupts(status);
+
+  for (int id = 0; mask; id++, mask >>= 1)
+  {
+    if (mask & 1)
+    {
+      schedule(id, now_ms());
+    }
+  }
+}
+
+//--------------------------------------------------------------------+
+// API
+//--------------------------------------------------------------------+
+
+int sched_add(char const *name, sched_fn_t fn)
+{
+  if (task_count >= SCHED_MAX_TASKS)
+  {
+    return -1;
+  }
+  int id = task_count++;
+  tasks[id] = (sched_task_t){.name = name, .fn = fn};
+  schedule(id, now_ms());
+  return id;
+}
+
+void sched_wake(int id)
+{
+  if (id >= 0 && id < task_count)
+  {
+    wake_mask |= 1u << id;
+  }
+}
+
+uint32_t sched_run(void)
+{
+  take_wakeups();
+
+  while (heap_size > 0 && (int32_t)(now_ms() - tasks[heap[0]].due_ms) >= 0)
+  {
+    int id = heap[0];
+    heap_remove_at(0);
+
+    sched_task_t *task = &tasks[id];
+    uint64_t start_us = time_us_64();
+    uint32_t next_ms = task->fn();
+    uint32_t run_us = (uint32_t)(time_us_64() - start_us);
+
+    task->runs++;
+    task->busy_us += run_us;
+    if (run_us > task->max_us)
+    {
+      task->max_us = run_us;
+    }
+
+    if (next_ms != SCHED_IDLE)
+    {
+      schedule(id, now_ms() + next_ms);
+    }
+    take_wakeups();
+  }
+
+  if (wake_mask)
+  {
+    return 0;
+  }
+  if (heap_size == 0)
+  {
+    return SCHED_IDLE;
+  }
+  int32_t wait_ms = (int32_t)(tasks[heap[0]].due_ms - now_ms());
+  return wait_ms > 0 ? (uint32_t)wait_ms : 0;
+}
+
+bool sched_get_stats(int id, sched_stats_t *stats)
+{
+  if (id < 0 || id >= task_count)
+  {
+    return false;
+  }
+  stats->name = tasks[id].name;
+  stats->runs = tasks[id].runs;
+  stats->max_us = tasks[id].max_us;
+  stats->busy_us = tasks[id].busy_us;
+  return true;
+}
+
+uint64_t sched_stats_elapsed_us(void)
+{
+  return time_us_64() - stats_start_us;
+}
+
+void sched_reset_stats(void)
+{
+  for (int id = 0; id < task_count; id++)
+  {
+    tasks[id].runs = 0;
+    tasks[id].max_us = 0;
+    tasks[id].busy_us = 0;
+  }
+  stats_start_us = time_us_64();
+}
+
+void sched_print_stats(void)
+{
+  uint64_t elapsed_us = sched_stats_elapsed_us();
+  printf("### TASKS: %lu ms ###\r\n", (unsigned long)(elapsed_us / 1000));
+  for (int id = 0; id < task_count; id++)
+  {
+    sched_task_t const *task = &tasks[id];
+    uint32_t load_permille = elapsed_us ? (uint32_t)(task->busy_us * 1000 / elapsed_us) : 0;
+    printf("###   %-12s runs=%lu busy=%lu.%lu%% max=%luus ###\r\n", task->name, (unsigned long)task->runs,
+           (unsigned long)(load_permille / 10), (unsigned long)(load_permille % 10), (unsigned long)task->max_us);
+  }
+}
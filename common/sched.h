@@ -0,0 +1,44 @@
+#ifndef SCHED_H_
+#define SCHED_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Cooperative task scheduler, shared by the hid and msc firmwares
+//
+// Tasks are kept in a min-heap ordered by their next deadline, and sched_run() dispatches the ones that are due.
+// A task returns the number of ms until it next needs to run, or SCHED_IDLE if it has no work, in which case it
+// sleeps until sched_wake() is called for it (usually from an interrupt handler).
+// The time spent in each task is measured, to show which task dominates the CPU.
+
+#define SCHED_MAX_TASKS 12 // at most 32, one bit each in the wake mask
+#define SCHED_IDLE UINT32_MAX
+
+typedef uint32_t (*sched_fn_t)(void);
+
+typedef struct
+{
+  char const *name;
+  uint32_t runs;
+  uint32_t max_us; // longest single run
+  uint64_t busy_us; // total run time
+} sched_stats_t;
+
+// Register a task. It is due immediately. Returns the task id, or -1 if the table is full.
+int sched_add(char const *name, sched_fn_t fn);
+
+// Make a task due now. Safe to call from an interrupt handler.
+void sched_wake(int id);
+
+// Run every task that is due. Returns the number of ms until the next deadline, 0 if a task was woken in the
+// meantime, or SCHED_IDLE if every task is waiting for sched_wake().
+uint32_t sched_run(void);
+
+bool sched_get_stats(int id, sched_stats_t *stats);
+
+// Time since the statistics were last reset, to turn busy_us into a CPU load
+uint64_t sched_stats_elapsed_us(void);
+void sched_reset_stats(void);
+void sched_print_stats(void);
+
+#endif /* SCHED_H_ */
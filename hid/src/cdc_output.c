@@ -0,0 +1,106 @@
+#include <stdio.h>
+
+#include "tusb.h"
+#include "cdc_output.h"
+#include "sched.h"
+
+#if CFG_TUD_CDC
+
+#define TEST_LINE_SIZE 16
+
+static uint32_t test_left = 0; // bytes of the throughput test still to send
+static uint32_t test_line = 0;
+static int cdc_test_task_id = -1;
+
+// Stream the test lines. Runs every ms while the test is on, and fills the TX FIFO each time.
+static uint32_t cdc_test_task(void)
+{
+  if (test_left == 0)
+  {
+    return SCHED_IDLE; // woken by tud_cdc_rx_cb()
+  }
+  if (!tud_cdc_connected())
+  {
+    test_left = 0; // the reader went away
+    return SCHED_IDLE;
+  }
+
+  while (test_left > 0 && tud_cdc_write_available() >= TEST_LINE_SIZE)
+  {
+    char line[TEST_LINE_SIZE + 1];
+    snprintf(line, sizeof(line), "%015lu\n", (unsigned long)test_line++);
+    tud_cdc_write(line, TEST_LINE_SIZE);
+    test_left -= TEST_LINE_SIZE;
+  }
+  tud_cdc_write_flush();
+  return 1;
+}
+
+void cdc_output_init(void)
+{
+  cdc_test_task_id = sched_add("cdc_test", cdc_test_task);
+}
+
+bool cdc_output_ready(void)
+{
+  return tud_cdc_connected() && test_left == 0;
+}
+
+uint32_t cdc_output_available(void)
+{
+  return tud_cdc_write_available();
+}
+
+bool cdc_output_write(uint8_t const *data, uint32_t len)
+{
+  if (tud_cdc_write_available() < len)
+  {
+    return false;
+  }
+  tud_cdc_write(data, len);
+  tud_cdc_write_flush();
+  return true;
+}
+
+// Invoked when the CDC interface received data from the host
+void tud_cdc_rx_cb(uint8_t itf)
+{
+  (void)itf;
+
+  uint8_t buf[64];
+  uint32_t count = tud_cdc_read(buf, sizeof(buf));
+  for (uint32_t i = 0; i < count; i++)
+  {
+    if (buf[i] == 'T' && test_left == 0)
+    {
+      test_left = CDC_TEST_BYTES / TEST_LINE_SIZE * TEST_LINE_SIZE;
+      test_line = 0;
+      sched_wake(cdc_test_task_id);
+    }
+  }
+}
+
+#else
+
+void cdc_output_init(void)
+{
+}
+
+bool cdc_output_ready(void)
+{
+  return false;
+}
+
+uint32_t cdc_output_available(void)
+{
+  return 0;
+}
+
+bool cdc_output_write(uint8_t const *data, uint32_t len)
+{
+  (void)data;
+  (void)len;
+  return false;
+}
+
+#endif
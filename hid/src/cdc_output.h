@@ -0,0 +1,31 @@
+#ifndef CDC_OUTPUT_H_
+#define CDC_OUTPUT_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Serial output
+// With HID_CDC set to 1 in tusb_config.h, the device also has a CDC-ACM serial port. While a program has the port
+// open (DTR set), records are written to it as they are, instead of being typed: no keyboard layout, no focus, and
+// USB bulk transfer rates. host/cdc_reader.py is a reader for linux.
+//
+// Sending 'T' to the port starts a throughput test: CDC_TEST_BYTES of numbered 16 byte lines are streamed as fast
+// as the USB bus takes them.
+
+#ifndef CDC_TEST_BYTES
+#define CDC_TEST_BYTES (4 * 1024 * 1024)
+#endif
+
+// Register the test task
+void cdc_output_init(void);
+
+// Whether records go to the serial port
+bool cdc_output_ready(void);
+
+// Bytes that can be written without blocking
+uint32_t cdc_output_available(void);
+
+// Write a record. Returns false if there isn't room for all of it.
+bool cdc_output_write(uint8_t const *data, uint32_t len);
+
+#endif /* CDC_OUTPUT_H_ */
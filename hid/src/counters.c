@@ -0,0 +1,28 @@
+#include <string.h>
+
+#include "counters.h"
+
+counters_t counters;
+
+static uint32_t histogram[COUNTERS_LATENCY_BUCKETS];
+
+void counters_latency(uint32_t ms)
+{
+  uint32_t bucket = 0;
+  while (ms > 0 && bucket < COUNTERS_LATENCY_BUCKETS - 1)
+  {
+    ms >>= 1;
+    bucket++;
+  }
+  histogram[bucket]++;
+}
+
+uint32_t const *counters_histogram(void)
+{
+  return histogram;
+}
+
+void counters_reset_histogram(void)
+{
+  memset(histogram, 0, sizeof(histogram));
+}
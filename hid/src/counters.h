@@ -0,0 +1,32 @@
+#ifndef COUNTERS_H_
+#define COUNTERS_H_
+
+#include <stdint.h>
+
+// Event counters and the record latency histogram, read by the PC through the raw HID feature reports
+// (raw_hid.h)
+
+typedef struct
+{
+  uint32_t rx_bytes;   // received from the MSC
+  uint32_t rx_dropped; // lost because the RX ring was full
+  uint32_t records;    // complete lines received
+  uint32_t typed;      // records typed on the keyboard
+  uint32_t serial;     // records written to the serial port
+  uint32_t raw;        // records sent on the raw HID interface
+  uint32_t journalled; // records written to the journal
+  uint32_t replayed;   // records read back from the journal
+} counters_t;
+
+extern counters_t counters;
+
+// Bucket 0 counts latencies under 1 ms, bucket n latencies of 2^(n-1) to 2^n - 1 ms. The last bucket is open.
+#define COUNTERS_LATENCY_BUCKETS 15
+
+// Count the time from the end of a record on the UART to the record leaving on USB
+void counters_latency(uint32_t ms);
+
+uint32_t const *counters_histogram(void);
+void counters_reset_histogram(void);
+
+#endif /* COUNTERS_H_ */
@@ -0,0 +1,413 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "bsp/board_api.h"
+#include "pico/stdlib.h"
+#include "hardware/flash.h"
+#include "hardware/sync.h"
+#include "tusb.h"
+#include "journal.h"
+#include "sched.h"
+
+#define JOURNAL_OFFSET (PICO_FLASH_SIZE_BYTES - JOURNAL_SECTORS * FLASH_SECTOR_SIZE)
+#define PAGES_PER_SECTOR (FLASH_SECTOR_SIZE / FLASH_PAGE_SIZE)
+#define JOURNAL_PAGES (JOURNAL_SECTORS * PAGES_PER_SECTOR)
+
+#define PAGE_MAGIC 0x4c4e524a // "JRNL"
+#define PAGE_DATA 1 // payload is records
+#define PAGE_ACK 2  // payload is the sequence number of the last replayed record
+
+typedef struct
+{
+  uint32_t magic;
+  uint32_t seq; // one more for every page programmed
+  uint16_t type;
+  uint16_t used; // bytes of payload
+  uint32_t crc;  // CRC32 of the payload, so that a page torn by a reset is ignored
+} page_header_t;
+
+#define PAGE_PAYLOAD (FLASH_PAGE_SIZE - sizeof(page_header_t))
+
+// A record in a data page: sequence number (4 bytes), length (1 byte), characters
+#define RECORD_HEADER 5
+
+static uint32_t head_page = 0; // next page to program
+static uint32_t page_seq = 1;  // sequence number of the next page
+static bool erase_due = false; // the sector at head_page must be erased before it is programmed
+
+static uint32_t record_seq = 0;   // last record appended
+static uint32_t flushed_seq = 0;  // last record programmed
+static uint32_t replayed_seq = 0; // last record replayed
+static uint32_t acked_seq = 0;    // last record replayed, as stored in flash
+
+// Replay position: the page and the offset in its payload of the next record to read. At head_page, the records
+// are read from page_buf, so records replayed before they were programmed never reach the flash.
+static uint32_t read_page = 0;
+static uint32_t read_off = 0;
+
+// Records waiting to be programmed
+static uint8_t page_buf[PAGE_PAYLOAD];
+static uint32_t buf_used = 0;
+static uint32_t buf_first_ms = 0;
+
+static int journal_task_id = -1;
+
+static bool seq_after(uint32_t a, uint32_t b)
+{
+  return (int32_t)(a - b) > 0;
+}
+
+static uint32_t crc32(uint8_t const *data, uint32_t len)
+{
+  uint32_t crc = 0xffffffff;
+  for (uint32_t i = 0; i < len; i++)
+  {
+    crc ^= data[i];
+    for (int b = 0; b < 8; b++)
+    {
+      crc = (crc >> 1) ^ (0xedb88320 & -(crc & 1));
+    }
+  }
+  return ~crc;
+}
+
+//--------------------------------------------------------------------+
+// Flash
+//--------------------------------------------------------------------+
+
+static page_header_t const *page_at(uint32_t page)
+{
+  return (page_header_t const *)(XIP_BASE + JOURNAL_OFFSET + page * FLASH_PAGE_SIZE);
+}
+
+static uint8_t const *page_payload(uint32_t page)
+{
+  return (uint8_t const *)(page_at(page) + 1);
+}
+
+static bool page_valid(uint32_t page)
+{
+  page_header_t const *h = page_at(page);
+  return h->magic == PAGE_MAGIC && h->used <= PAGE_PAYLOAD && h->crc == crc32(page_payload(page), h->used);
+}
+
+static bool page_blank(uint32_t page)
+{
+  uint32_t const *p = (uint32_t const *)page_at(page);
+  for (uint32_t i = 0; i < FLASH_PAGE_SIZE / 4; i++)
+  {
+    if (p[i] != 0xffffffff)
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+static uint32_t next_page(uint32_t page)
+{
+  return (page + 1) % JOURNAL_PAGES;
+}
+
+// Erasing takes tens of ms with interrupts disabled, long enough for the PC to see the keyboard and the replay
+// stall. It is done ahead of time by the journal task, while the PC is away, or while the journal has nothing to
+// replay or program. Programming a page only takes a fraction of a ms.
+static bool erase_allowed(void)
+{
+  return !tud_mounted() || tud_suspended() || (!journal_pending() && buf_used == 0);
+}
+
+// Whether the next page can be programmed without an erase that has to wait
+static bool program_allowed(void)
+{
+  return head_page % PAGES_PER_SECTOR != 0 || page_blank(head_page) || erase_allowed();
+}
+
+static void erase_sector(uint32_t sector)
+{
+  // The replay position is at the head of the log both when all records are in page_buf, and when the log is full
+  bool in_flash = read_page != head_page || seq_after(flushed_seq, replayed_seq);
+  if (journal_pending() && read_page / PAGES_PER_SECTOR == sector && in_flash)
+  {
+    // The log has wrapped onto records that were never replayed
+    printf("### JOURNAL FULL: OLDEST RECORDS DROPPED ###\r\n");
+    read_page = ((sector + 1) % JOURNAL_SECTORS) * PAGES_PER_SECTOR;
+    read_off = 0;
+  }
+
+  uint32_t status = save_and_disable_interrupts();
+  flash_range_erase(JOURNAL_OFFSET + sector * FLASH_SECTOR_SIZE, FLASH_SECTOR_SIZE);
+  restore_interrupts(status);
+}
+
+// Program a page at the head of the log. Pages that can't be programmed (not erased, or torn) are skipped.
+static bool program_page(uint16_t type, uint8_t const *payload, uint32_t used)
+{
+  static uint8_t page[FLASH_PAGE_SIZE];
+
+  for (uint32_t tries = 0; tries < 2 * PAGES_PER_SECTOR; tries++)
+  {
+    if (!page_blank(head_page))
+    {
+      if (head_page % PAGES_PER_SECTOR != 0)
+      {
+        head_page = next_page(head_page);
+        continue;
+      }
+      erase_sector(head_page / PAGES_PER_SECTOR);
+    }
+
+    memset(page, 0xff, sizeof(page));
+    page_header_t *h = (page_header_t *)page;
+    h->magic = PAGE_MAGIC;
+    h->seq = page_seq;
+    h->type = type;
+    h->used = (uint16_t)used;
+    h->crc = crc32(payload, used);
+    memcpy(h + 1, payload, used);
+
+    uint32_t status = save_and_disable_interrupts();
+    flash_range_program(JOURNAL_OFFSET + head_page * FLASH_PAGE_SIZE, page, FLASH_PAGE_SIZE);
+    restore_interrupts(status);
+
+    bool ok = memcmp(page_at(head_page), page, FLASH_PAGE_SIZE) == 0;
+    head_page = next_page(head_page);
+    if (ok)
+    {
+      page_seq++;
+      if (head_page % PAGES_PER_SECTOR == 0 && !page_blank(head_page))
+      {
+        erase_due = true;
+        sched_wake(journal_task_id);
+      }
+      return true;
+    }
+  }
+  printf("### JOURNAL: FLASH WRITE FAILED ###\r\n");
+  return false;
+}
+
+static void flush_page(void)
+{
+  if (buf_used > 0)
+  {
+    if (program_page(PAGE_DATA, page_buf, buf_used))
+    {
+      flushed_seq = record_seq; // page_buf holds the newest records
+    }
+    buf_used = 0;
+  }
+}
+
+static void store_ack(void)
+{
+  uint8_t payload[4];
+  memcpy(payload, &replayed_seq, sizeof(payload));
+  if (program_page(PAGE_ACK, payload, sizeof(payload)))
+  {
+    acked_seq = replayed_seq;
+  }
+}
+
+//--------------------------------------------------------------------+
+// Task
+//--------------------------------------------------------------------+
+
+static uint32_t journal_task(void)
+{
+  if (!program_allowed())
+  {
+    return JOURNAL_FLUSH_MS; // the records stay in RAM, where the replay reads them, until the erase can be done
+  }
+
+  if (buf_used > 0)
+  {
+    uint32_t age_ms = board_millis() - buf_first_ms;
+    if (age_ms < JOURNAL_FLUSH_MS)
+    {
+      return JOURNAL_FLUSH_MS - age_ms;
+    }
+    flush_page();
+  }
+
+  // Only needed if the flash holds records that are not acknowledged yet
+  if (!journal_pending() && seq_after(flushed_seq, acked_seq))
+  {
+    store_ack();
+  }
+
+  if (erase_due)
+  {
+    if (!erase_allowed())
+    {
+      return JOURNAL_FLUSH_MS;
+    }
+    erase_due = false;
+    if (head_page % PAGES_PER_SECTOR == 0 && !page_blank(head_page))
+    {
+      erase_sector(head_page / PAGES_PER_SECTOR);
+    }
+  }
+  return SCHED_IDLE; // woken when there is something to write
+}
+
+//--------------------------------------------------------------------+
+// API
+//--------------------------------------------------------------------+
+
+void journal_init(void)
+{
+  bool found = false;
+  uint32_t newest_ack_page_seq = 0;
+
+  for (uint32_t page = 0; page < JOURNAL_PAGES; page++)
+  {
+    if (!page_valid(page))
+    {
+      continue;
+    }
+    page_header_t const *h = page_at(page);
+    uint8_t const *payload = page_payload(page);
+
+    if (!found || seq_after(h->seq, page_seq - 1))
+    {
+      page_seq = h->seq + 1;
+      head_page = next_page(page);
+    }
+
+    if (h->type == PAGE_ACK && h->used == 4 && (!found || seq_after(h->seq, newest_ack_page_seq)))
+    {
+      memcpy(&acked_seq, payload, 4);
+      newest_ack_page_seq = h->seq;
+    }
+    else if (h->type == PAGE_DATA)
+    {
+      for (uint32_t off = 0; off + RECORD_HEADER <= h->used; off += RECORD_HEADER + payload[off + 4])
+      {
+        uint32_t seq;
+        memcpy(&seq, &payload[off], 4);
+        if (record_seq == 0 || seq_after(seq, record_seq))
+        {
+          record_seq = seq;
+        }
+      }
+    }
+    found = true;
+  }
+  if (seq_after(acked_seq, record_seq))
+  {
+    acked_seq = record_seq;
+  }
+  flushed_seq = record_seq;
+  replayed_seq = acked_seq;
+
+  // The oldest page follows the head of the log
+  read_page = head_page;
+  for (uint32_t n = 0; n < JOURNAL_PAGES && found && !page_valid(read_page); n++)
+  {
+    read_page = next_page(read_page);
+  }
+  read_off = 0;
+
+  printf("### JOURNAL: %lu RECORDS TO REPLAY ###\r\n", (unsigned long)(record_seq - replayed_seq));
+  journal_task_id = sched_add("journal", journal_task);
+}
+
+bool journal_append(uint8_t const *data, uint32_t len)
+{
+  if (len == 0 || len > JOURNAL_RECORD_MAX)
+  {
+    return false;
+  }
+  if (buf_used + RECORD_HEADER + len > PAGE_PAYLOAD && read_page == head_page && read_off > 0)
+  {
+    // The records replayed from RAM never need to be programmed
+    memmove(page_buf, &page_buf[read_off], buf_used - read_off);
+    buf_used -= read_off;
+    read_off = 0;
+  }
+  if (buf_used + RECORD_HEADER + len > PAGE_PAYLOAD)
+  {
+    if (!program_allowed())
+    {
+      // Records arrive faster than the PC takes the replay, and the sector ahead is still to be erased
+      printf("### JOURNAL: SECTOR ERASED DURING A REPLAY ###\r\n");
+    }
+    flush_page(); // the page is full
+  }
+  if (buf_used == 0)
+  {
+    buf_first_ms = board_millis();
+  }
+  if (!journal_pending())
+  {
+    // Start replaying from this record, wherever it ends up
+    read_page = head_page;
+    read_off = 0;
+  }
+
+  record_seq++;
+  memcpy(&page_buf[buf_used], &record_seq, 4);
+  page_buf[buf_used + 4] = (uint8_t)len;
+  memcpy(&page_buf[buf_used + RECORD_HEADER], data, len);
+  buf_used += RECORD_HEADER + len;
+
+  sched_wake(journal_task_id);
+  return true;
+}
+
+bool journal_pending(void)
+{
+  return seq_after(record_seq, replayed_seq);
+}
+
+uint32_t journal_next(uint8_t *data)
+{
+  while (journal_pending())
+  {
+    uint8_t const *payload = NULL;
+    uint32_t used = 0;
+    if (read_page == head_page)
+    {
+      payload = page_buf; // the newest records are still in RAM
+      used = buf_used;
+    }
+    else if (page_valid(read_page) && page_at(read_page)->type == PAGE_DATA)
+    {
+      payload = page_payload(read_page);
+      used = page_at(read_page)->used;
+    }
+
+    if (payload && read_off + RECORD_HEADER <= used)
+    {
+      uint32_t seq;
+      memcpy(&seq, &payload[read_off], 4);
+      uint32_t len = payload[read_off + 4];
+      uint8_t const *record = &payload[read_off + RECORD_HEADER];
+      read_off += RECORD_HEADER + len;
+      if (seq_after(seq, replayed_seq) && len <= JOURNAL_RECORD_MAX)
+      {
+        memcpy(data, record, len);
+        replayed_seq = seq;
+        if (!journal_pending())
+        {
+          buf_used = 0; // replayed, so there is no need to program them
+          sched_wake(journal_task_id); // store the replay position
+        }
+        return len;
+      }
+      continue;
+    }
+
+    if (read_page == head_page)
+    {
+      replayed_seq = record_seq; // the rest was lost when the log wrapped
+      buf_used = 0;
+      break;
+    }
+    read_page = next_page(read_page);
+    read_off = 0;
+  }
+  sched_wake(journal_task_id);
+  return 0;
+}
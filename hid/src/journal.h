@@ -0,0 +1,41 @@
+#ifndef JOURNAL_H_
+#define JOURNAL_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Reading journal
+// Records (lines received from the MSC) that arrive while the PC is unmounted or suspended are appended to a
+// log in the last JOURNAL_SECTORS of the flash, each with a sequence number, and replayed in order once the PC
+// is back. Records are batched in RAM and programmed a whole page at a time. The log is written round-robin
+// through its sectors, so every sector is erased once per lap. When it wraps onto records that were never
+// replayed, the oldest records are dropped.
+// A sector erase keeps the interrupts off for tens of ms, so it is only done while the PC is away, or while the
+// journal is idle, ahead of the page that needs it. During a replay, new records wait in RAM rather than force an
+// erase, unless the RAM page fills up first.
+
+#ifndef JOURNAL_SECTORS
+#define JOURNAL_SECTORS 32 // 128 KB
+#endif
+
+// A page is programmed once it is full, or once its oldest record has waited this long
+#ifndef JOURNAL_FLUSH_MS
+#define JOURNAL_FLUSH_MS 2000
+#endif
+
+#define JOURNAL_RECORD_MAX 64
+
+// Find the end of the log and the replay position, and register the journal task
+void journal_init(void);
+
+// Append a record. Returns false if it is longer than JOURNAL_RECORD_MAX.
+bool journal_append(uint8_t const *data, uint32_t len);
+
+// Whether there are records that were not replayed yet
+bool journal_pending(void);
+
+// Copy the oldest record that was not replayed yet into data (JOURNAL_RECORD_MAX bytes) and mark it as replayed.
+// Returns its length, or 0 if there is none. The replay position is stored in flash once all records are replayed.
+uint32_t journal_next(uint8_t *data);
+
+#endif /* JOURNAL_H_ */
@@ -29,8 +29,20 @@
 
 #include "bsp/board_api.h"
 #include "tusb.h"
+#include "pico/stdlib.h"
 #include "hardware/uart.h"
 #include "hardware/gpio.h"
+#include "hardware/irq.h"
+#include "hardware/sync.h"
+#include "hardware/structs/scb.h"
+#include "sched.h"
+#include "journal.h"
+#include "cdc_output.h"
+#include "raw_hid.h"
+#include "counters.h"
+#include "uart_sources.h"
+#include "typing_pace.h"
+#include "hot_path.h"
 
 // UART defines
 #define BAUD_RATE 9600 // 115200
@@ -45,7 +57,7 @@
 enum
 {
   ITF_KEYBOARD = 0,
-  ITF_MOUSE = 1
+  ITF_MOUSE = 1 // then the raw interface, RAW_HID_ITF
 };
 
 /* Blink pattern
@@ -62,9 +74,17 @@ enum
 
 static uint32_t blink_interval_ms = BLINK_NOT_MOUNTED;
 
-void led_blinking_task(void);
-void hid_task(void);
-void uart_data_task(void);
+// Tasks are run by the scheduler (common/sched.c). They return the number of ms until they next need to run,
+// or SCHED_IDLE when they have no work and will be woken by an interrupt.
+uint32_t usb_task(void);
+uint32_t led_blinking_task(void);
+uint32_t hid_task(void);
+uint32_t uart_data_task(void);
+
+static int usb_task_id;
+static int uart_data_task_id;
+
+static void wait_for_event(uint32_t sleep_ms);
 
 /*------------- MAIN -------------*/
 int main(void)
@@ -87,12 +107,48 @@ int main(void)
     board_init_after_tusb();
   }
 
+  // Any interrupt that becomes pending wakes the core from __wfe(), even one raised just before going to sleep
+  scb_hw->scr |= M33_SCR_SEVONPEND_BITS;
+
+  usb_task_id = sched_add("usb", usb_task);
+  sched_add("led", led_blinking_task);
+  sched_add("hid", hid_task);
+  uart_data_task_id = sched_add("uart_data", uart_data_task);
+  uart_sources_init(uart_data_task_id, BAUD_RATE);
+  typing_pace_init(uart_data_task_id);
+  journal_init();
+  cdc_output_init();
+
   while (1)
   {
-    tud_task(); // tinyusb device task
-    led_blinking_task();
-    hid_task();
-    uart_data_task();
+    if (tud_task_event_ready())
+    {
+      sched_wake(usb_task_id);
+    }
+    wait_for_event(sched_run());
+  }
+}
+
+uint32_t usb_task(void)
+{
+  tud_task(); // tinyusb device task
+  return SCHED_IDLE; // woken when the USB interrupt queues an event
+}
+
+// Sleep until an interrupt (USB, UART RX) or until the next task is due
+static void wait_for_event(uint32_t sleep_ms)
+{
+  if (sleep_ms == 0 || tud_task_event_ready())
+  {
+    return;
+  }
+  if (sleep_ms == SCHED_IDLE)
+  {
+    __wfe();
+  }
+  else
+  {
+    best_effort_wfe_or_timeout(make_timeout_time_ms(sleep_ms));
   }
 }
 
@@ -104,12 +160,15 @@ int main(void)
 void tud_mount_cb(void)
 {
   blink_interval_ms = BLINK_MOUNTED;
+  sched_wake(uart_data_task_id); // replay the journal
 }
 
 // Invoked when device is unmounted
 void tud_umount_cb(void)
 {
   blink_interval_ms = BLINK_NOT_MOUNTED;
+  raw_hid_reset();
+  typing_pace_reset();
 }
 
 // Invoked when usb bus is suspended
@@ -125,21 +184,17 @@ void tud_suspend_cb(bool remote_wakeup_en)
 void tud_resume_cb(void)
 {
   blink_interval_ms = tud_mounted() ? BLINK_MOUNTED : BLINK_NOT_MOUNTED;
+  sched_wake(uart_data_task_id); // replay the journal
 }
 
 //--------------------------------------------------------------------+
 // USB HID
 //--------------------------------------------------------------------+
 
-void hid_task(void)
+uint32_t hid_task(void)
 {
-  // Poll every 10ms
+  // Poll every 10ms. The button has no interrupt, so this task always has work.
   const uint32_t interval_ms = 10;
-  static uint32_t start_ms = 0;
-
-  if (board_millis() - start_ms < interval_ms)
-    return; // not enough time
-  start_ms += interval_ms;
 
   uint32_t const btn = board_button_read();
 
@@ -201,30 +256,170 @@ void hid_task(void)
       seq_idx = 0;
     }
   }
+  return interval_ms;
 }
 
 /*------------- Enter data from UART -------------*/
-void uart_data_task(void)
+// Received characters are collected into records (lines), from each source in turn (uart_sources.h). A record is
+// typed if the PC is ready for it, unless a program asked for the records on the raw HID interface (raw_hid.h) or
+// the serial port (cdc_output.h). Otherwise it is journalled to flash, to be sent once the PC is mounted or resumed.
+// Journalled records are sent before new ones, so that the readings stay in order.
+#define NOT_TIMED UINT32_MAX // the record came from the journal, so its latency isn't known
+
+static uint8_t typing[JOURNAL_RECORD_MAX]; // the record being sent, held until it can be
+static uint32_t typing_len = 0;
+static uint32_t typing_pos = 0;
+static uint32_t typing_rx_ms = NOT_TIMED;
+
+static bool HOT_FUNC(host_ready)(void)
+{
+  return tud_mounted() && !tud_suspended();
+}
+
+// Journal the records received so far
+static void HOT_FUNC(journal_rx_records)(void)
+{
+  static uint8_t record[JOURNAL_RECORD_MAX];
+  uint32_t rx_ms;
+  uint32_t len;
+  while ((len = uart_sources_next_record(record, &rx_ms)) > 0)
+  {
+    journal_append(record, len);
+    counters.journalled++;
+  }
+}
+
+// Take the next record to send into data: the journal first, so that the records stay in order.
+// Returns its length, or 0 if there is none.
+static uint32_t HOT_FUNC(next_record)(uint8_t *data, uint32_t *rx_ms)
+{
+  if (journal_pending())
+  {
+    journal_rx_records(); // new records queue up behind the journal, rather than in the RX rings
+    uint32_t len = journal_next(data);
+    if (len > 0)
+    {
+      counters.replayed++;
+    }
+    *rx_ms = NOT_TIMED;
+    return len;
+  }
+  return uart_sources_next_record(data, rx_ms);
+}
+
+// Count a record that has been handed to USB
+static void HOT_FUNC(record_sent)(uint32_t *counter, uint32_t rx_ms)
+{
+  (*counter)++;
+  if (rx_ms != NOT_TIMED)
+  {
+    counters_latency(board_millis() - rx_ms);
+  }
+}
+
+uint32_t HOT_FUNC(uart_data_task)(void)
 {
   static bool sent_keycode = false;  // track if a keycode was sent last, to sent en empty report next if it was
-  
-  // Poll every 10ms
-  const uint32_t interval_ms = 10;
+
+  // Run every 10ms while there is work, or at the pace the PC keeps up with (typing_pace.h)
+  const uint32_t interval_ms = typing_pace_interval_ms();
   static uint32_t start_ms = 0;
+
+  if (!host_ready())
+  {
+    // Keep what is left of the record being sent, then everything received
+    if (typing_pos < typing_len)
+    {
+      journal_append(&typing[typing_pos], typing_len - typing_pos);
+      counters.journalled++;
+    }
+    typing_pos = typing_len = 0;
+    journal_rx_records();
+    sent_keycode = false;
+    return SCHED_IDLE; // woken by the RX interrupt, or by tud_mount_cb() and tud_resume_cb()
+  }
+
+  if (typing_pos == typing_len)
+  {
+    typing_pos = typing_len = 0;
+  }
+
+  if (!sent_keycode && typing_pos == 0 && raw_hid_ready())
+  {
+    // One report per frame, with as many whole records as fit
+    if (!tud_hid_n_ready(RAW_HID_ITF))
+      return 1;
+    while (1)
+    {
+      if (typing_len == 0)
+        typing_len = next_record(typing, &typing_rx_ms);
+      if (typing_len == 0 || !raw_hid_write(typing, typing_len))
+        break;
+      record_sent(&counters.raw, typing_rx_ms);
+      typing_len = 0;
+    }
+    raw_hid_send();
+    return typing_len > 0 ? 1 : SCHED_IDLE; // a record that didn't fit goes in the next frame
+  }
+
+  if (!sent_keycode && typing_pos == 0 && cdc_output_ready())
+  {
+    // The serial port takes whole records, as fast as they come
+    while (cdc_output_available() >= JOURNAL_RECORD_MAX)
+    {
+      if (typing_len == 0)
+        typing_len = next_record(typing, &typing_rx_ms);
+      if (typing_len == 0)
+        return SCHED_IDLE; // woken by the RX interrupt
+      cdc_output_write(typing, typing_len);
+      record_sent(&counters.serial, typing_rx_ms);
+      typing_len = 0;
+    }
+    return 1; // TX FIFO full
+  }
+
+  if (!sent_keycode && typing_len == 0 && !typing_pace_probing() && !journal_pending() && !uart_sources_available())
+    return SCHED_IDLE; // woken by the RX interrupt
+
+  // Wait for the PC to catch up with the keys typed so far
+  uint32_t const wait_ms = sent_keycode ? 0 : typing_pace_wait_ms();
+  if (wait_ms > 0)
+    return wait_ms; // woken by the LED report
+
+  // A wake-up from the RX interrupt may come early
   if (board_millis() - start_ms < interval_ms)
-    return; // not enough time
-  start_ms += interval_ms;
+    return interval_ms - (board_millis() - start_ms); // not enough time
+  start_ms = board_millis();
 
   if (sent_keycode) {
     sent_keycode = false;
     tud_hid_n_keyboard_report(ITF_KEYBOARD, 0, 0, NULL);
-    return;
+    return interval_ms;
+  }
+
+  if (typing_pace_probing())
+  {
+    if (tud_hid_n_ready(ITF_KEYBOARD))
+    {
+      uint8_t keycode[6] = {typing_pace_probe_key()};
+      tud_hid_n_keyboard_report(ITF_KEYBOARD, 0, 0, keycode);
+    }
+    return interval_ms;
   }
 
-  if (uart_is_readable(uart1) && tud_hid_n_ready(ITF_KEYBOARD))
+  if (typing_len == 0)
+  {
+    typing_len = next_record(typing, &typing_rx_ms);
+  }
+
+  if (typing_pos < typing_len && tud_hid_n_ready(ITF_KEYBOARD))
   {
     uint8_t keycode[6] = {0};
-    char ch = uart_getc(uart1); // Read character from UART
+    char ch = (char)typing[typing_pos++];
+    if (typing_pos == typing_len)
+    {
+      record_sent(&counters.typed, typing_rx_ms);
+    }
 
     switch (ch)
     {
@@ -261,9 +456,18 @@ void uart_data_task(void)
     case '.':
       keycode[0] = HID_KEY_PERIOD;
       break;
+    case ',':
+      keycode[0] = HID_KEY_COMMA; // decimal separator with POINT=, on the MSC
+      break;
+    case '-':
+      keycode[0] = HID_KEY_MINUS;
+      break;
     case '\n':
       keycode[0] = HID_KEY_ENTER;
       break;
+    case '\t':
+      keycode[0] = HID_KEY_TAB; // after the source number
+      break;
     default:
       break; // Ignore unsupported characters
     }
@@ -272,8 +476,10 @@ void uart_data_task(void)
     {
       tud_hid_n_keyboard_report(ITF_KEYBOARD, 0, 0, keycode);
       sent_keycode = true;
+      typing_pace_typed(typing_pos == typing_len);
     }
   }
+  return interval_ms;
 }
 
 // Invoked when received GET_REPORT control request
@@ -281,8 +487,12 @@ void uart_data_task(void)
 // Return zero will cause the stack to STALL request
 uint16_t tud_hid_get_report_cb(uint8_t itf, uint8_t report_id, hid_report_type_t report_type, uint8_t *buffer, uint16_t reqlen)
 {
-  // TODO not Implemented
-  (void)itf;
+  if (itf == RAW_HID_ITF)
+  {
+    return raw_hid_get_report(report_id, report_type, buffer, reqlen);
+  }
+
+  // TODO not Implemented for the keyboard and the mouse
   (void)report_id;
   (void)report_type;
   (void)buffer;
@@ -295,27 +505,30 @@ uint16_t tud_hid_get_report_cb(uint8_t itf, uint8_t report_id, hid_report_type_t
 // received data on OUT endpoint ( Report ID = 0, Type = 0 )
 void tud_hid_set_report_cb(uint8_t itf, uint8_t report_id, hid_report_type_t report_type, uint8_t const *buffer, uint16_t bufsize)
 {
-  // TODO set LED based on CAPLOCK, NUMLOCK etc...
-  (void)itf;
+  if (itf == RAW_HID_ITF)
+  {
+    raw_hid_set_report(report_id, report_type, buffer, bufsize);
+    return;
+  }
+
+  // The LED report of the keyboard: the PC echoes the lock keys typed by typing_pace.c
+  if (itf == ITF_KEYBOARD && report_type == HID_REPORT_TYPE_OUTPUT && bufsize >= 1)
+  {
+    typing_pace_leds(buffer[0]);
+  }
   (void)report_id;
-  (void)report_type;
-  (void)buffer;
-  (void)bufsize;
 }
 
 //--------------------------------------------------------------------+
 // BLINKING TASK
 //--------------------------------------------------------------------+
-void led_blinking_task(void)
+uint32_t led_blinking_task(void)
 {
-  static uint32_t start_ms = 0;
   static bool led_state = false;
 
-  // Blink every interval ms
-  if (board_millis() - start_ms < blink_interval_ms)
-    return; // not enough time
-  start_ms += blink_interval_ms;
-
   board_led_write(led_state);
   led_state = 1 - led_state; // toggle
+
+  // Blink every interval ms
+  return blink_interval_ms;
 }
@@ -0,0 +1,162 @@
+#include <string.h>
+
+#include "bsp/board_api.h"
+#include "tusb.h"
+#include "raw_hid.h"
+#include "counters.h"
+#include "sched.h"
+
+static uint8_t mode = RAW_HID_MODE_KEYBOARD;
+static uint32_t lease_ms = 0;
+static uint32_t lease_start_ms = 0;
+
+static uint8_t report[RAW_HID_REPORT_SIZE];
+static uint32_t report_used = 1; // byte 0 is the record count
+
+static void put_u32(uint8_t *p, uint32_t v)
+{
+  p[0] = (uint8_t)v;
+  p[1] = (uint8_t)(v >> 8);
+  p[2] = (uint8_t)(v >> 16);
+  p[3] = (uint8_t)(v >> 24);
+}
+
+bool raw_hid_ready(void)
+{
+  if (mode != RAW_HID_MODE_RECORDS || !tud_mounted())
+  {
+    return false;
+  }
+  if (lease_ms && board_millis() - lease_start_ms >= lease_ms)
+  {
+    mode = RAW_HID_MODE_KEYBOARD; // the PC program went away
+    return false;
+  }
+  return true;
+}
+
+bool raw_hid_write(uint8_t const *data, uint32_t len)
+{
+  if (len > RAW_HID_REPORT_SIZE - 2)
+  {
+    len = RAW_HID_REPORT_SIZE - 2;
+  }
+  if (report_used + 1 + len > RAW_HID_REPORT_SIZE)
+  {
+    return false;
+  }
+  report[0]++;
+  report[report_used++] = (uint8_t)len;
+  memcpy(&report[report_used], data, len);
+  report_used += len;
+  return true;
+}
+
+void raw_hid_send(void)
+{
+  if (report[0] == 0)
+  {
+    return;
+  }
+  memset(&report[report_used], 0, RAW_HID_REPORT_SIZE - report_used);
+  tud_hid_n_report(RAW_HID_ITF, RAW_HID_REPORT_RECORDS, report, RAW_HID_REPORT_SIZE);
+  report[0] = 0;
+  report_used = 1;
+}
+
+void raw_hid_reset(void)
+{
+  mode = RAW_HID_MODE_KEYBOARD;
+}
+
+//--------------------------------------------------------------------+
+// Feature reports
+//--------------------------------------------------------------------+
+
+static uint16_t get_tasks(uint8_t *buffer)
+{
+  uint64_t elapsed_us = sched_stats_elapsed_us();
+  uint32_t off = 0;
+  put_u32(&buffer[off], (uint32_t)(elapsed_us / 1000));
+  off += 4;
+
+  sched_stats_t stats;
+  for (int id = 0; off + 6 <= RAW_HID_REPORT_SIZE && sched_get_stats(id, &stats); id++)
+  {
+    uint32_t load_permille = elapsed_us ? (uint32_t)(stats.busy_us * 1000 / elapsed_us) : 0;
+    put_u32(&buffer[off], stats.max_us);
+    buffer[off + 4] = (uint8_t)load_permille;
+    buffer[off + 5] = (uint8_t)(load_permille >> 8);
+    off += 6;
+  }
+  return RAW_HID_REPORT_SIZE;
+}
+
+uint16_t raw_hid_get_report(uint8_t report_id, hid_report_type_t report_type, uint8_t *buffer, uint16_t reqlen)
+{
+  if (report_type != HID_REPORT_TYPE_FEATURE || reqlen < RAW_HID_REPORT_SIZE)
+  {
+    return 0;
+  }
+  memset(buffer, 0, RAW_HID_REPORT_SIZE);
+
+  switch (report_id)
+  {
+  case RAW_HID_REPORT_COUNTERS:
+    put_u32(buffer, board_millis());
+    for (uint32_t i = 0; i < sizeof(counters_t) / 4; i++)
+    {
+      put_u32(&buffer[4 + 4 * i], ((uint32_t const *)&counters)[i]);
+    }
+    return RAW_HID_REPORT_SIZE;
+
+  case RAW_HID_REPORT_LATENCY:
+    for (uint32_t i = 0; i < COUNTERS_LATENCY_BUCKETS; i++)
+    {
+      put_u32(&buffer[4 * i], counters_histogram()[i]);
+    }
+    return RAW_HID_REPORT_SIZE;
+
+  case RAW_HID_REPORT_TASKS:
+    return get_tasks(buffer);
+
+  case RAW_HID_REPORT_MODE:
+    buffer[0] = mode;
+    buffer[1] = (uint8_t)(lease_ms / 1000);
+    return RAW_HID_REPORT_SIZE;
+
+  default:
+    return 0; // STALL
+  }
+}
+
+void raw_hid_set_report(uint8_t report_id, hid_report_type_t report_type, uint8_t const *buffer, uint16_t bufsize)
+{
+  if (report_type != HID_REPORT_TYPE_FEATURE)
+  {
+    return;
+  }
+
+  switch (report_id)
+  {
+  case RAW_HID_REPORT_LATENCY:
+    counters_reset_histogram();
+    break;
+
+  case RAW_HID_REPORT_TASKS:
+    sched_reset_stats();
+    break;
+
+  case RAW_HID_REPORT_MODE:
+    if (bufsize >= 2 && buffer[0] <= RAW_HID_MODE_RECORDS)
+    {
+      mode = buffer[0];
+      lease_ms = buffer[1] * 1000u;
+      lease_start_ms = board_millis();
+    }
+    break;
+
+  default:
+    break;
+  }
+}
@@ -0,0 +1,58 @@
+#ifndef RAW_HID_H_
+#define RAW_HID_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "tusb.h"
+
+// Raw HID interface
+// A vendor defined HID interface with 64 byte reports, that a PC program can use without a driver (hidraw on
+// linux, HidD_* on windows). Every report has a report ID and 63 bytes of data:
+//
+//   ID 1, input:   records. Byte 0 is the number of records in the report, followed by the records, each a
+//                  length byte and the characters. Records are never split, and are cut to 61 characters.
+//                  Up to one report is sent per 1 ms frame.
+//   ID 2, feature: uptime in ms, then the counters_t fields (counters.h), all uint32_t little endian.
+//   ID 3, feature: the latency histogram, COUNTERS_LATENCY_BUCKETS uint32_t. Setting it clears the histogram.
+//   ID 4, feature: scheduler stats. uint32_t ms since the last reset, then per task in the order they were
+//                  added (usb, led, hid, uart_data, ...) uint32_t longest run in us and uint16_t load in 0.1 %.
+//                  Setting it resets the stats.
+//   ID 5, feature: mode. Byte 0 is RAW_HID_MODE_*, byte 1 the lease in s (0: until unmounted). Records are sent
+//                  on this interface instead of being typed while the lease runs; renew it by setting it again.
+
+#define RAW_HID_ITF 2 // HID instance, after the keyboard and the mouse
+#define RAW_HID_REPORT_SIZE 63
+
+enum
+{
+  RAW_HID_REPORT_RECORDS = 1,
+  RAW_HID_REPORT_COUNTERS,
+  RAW_HID_REPORT_LATENCY,
+  RAW_HID_REPORT_TASKS,
+  RAW_HID_REPORT_MODE,
+};
+
+enum
+{
+  RAW_HID_MODE_KEYBOARD = 0,
+  RAW_HID_MODE_RECORDS = 1,
+};
+
+// Whether records go to the raw interface
+bool raw_hid_ready(void);
+
+// Add a record to the report being built. Returns false if there isn't room for it, and the report must be sent
+// first.
+bool raw_hid_write(uint8_t const *data, uint32_t len);
+
+// Send the report being built. Check tud_hid_n_ready(RAW_HID_ITF) before building it.
+void raw_hid_send(void);
+
+// Back to typing, e.g. when the PC unmounts the device
+void raw_hid_reset(void);
+
+uint16_t raw_hid_get_report(uint8_t report_id, hid_report_type_t report_type, uint8_t *buffer, uint16_t reqlen);
+void raw_hid_set_report(uint8_t report_id, hid_report_type_t report_type, uint8_t const *buffer, uint16_t bufsize);
+
+#endif /* RAW_HID_H_ */
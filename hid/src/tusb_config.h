@@ -90,15 +90,28 @@
 #define CFG_TUD_ENDPOINT0_SIZE    64
 #endif
 
+// Set to 1 to add a CDC-ACM serial port for the records (see cdc_output.h)
+#ifndef HID_CDC
+#define HID_CDC                   0
+#endif
+
 //------------- CLASS -------------//
-#define CFG_TUD_HID               2
-#define CFG_TUD_CDC               0
+#define CFG_TUD_HID               3
+#define CFG_TUD_CDC               HID_CDC
 #define CFG_TUD_MSC               0
 #define CFG_TUD_MIDI              0
 #define CFG_TUD_VENDOR            0
 
 // HID buffer size Should be sufficient to hold ID (if any) + Data
-#define CFG_TUD_HID_EP_BUFSIZE    8
+// 64 for the raw HID interface, the keyboard and mouse endpoints stay at 8 bytes
+#define CFG_TUD_HID_EP_BUFSIZE    64
+
+// CDC FIFO size of TX and RX. The TX FIFO holds several frames of data, so the bus is kept busy between tasks.
+#define CFG_TUD_CDC_RX_BUFSIZE    64
+#define CFG_TUD_CDC_TX_BUFSIZE    4096
+
+// CDC endpoint transfer size. Larger than a full speed packet, so one transfer moves several packets.
+#define CFG_TUD_CDC_EP_BUFSIZE    512
 
 #ifdef __cplusplus
  }
@@ -0,0 +1,146 @@
+#include <stdio.h>
+
+#include "bsp/board_api.h"
+#include "tusb.h"
+#include "typing_pace.h"
+#include "sched.h"
+
+#if TYPING_PACE
+
+#define PROBE_REPORTS 4 // press, release, press, release
+
+static int pace_task_id = -1;
+static uint32_t interval_ms = TYPING_PACE_START_MS;
+static uint32_t keys = 0; // typed since the last probe
+static bool disabled = false; // the PC doesn't echo
+static bool echoed = false;   // the PC echoed a probe since it was mounted
+static uint32_t timeouts = 0; // probes in a row without an echo
+static bool backed_off = false; // until the first back off, the interval is halved rather than shortened
+
+static bool probing = false;
+static uint8_t probe_sent = 0; // reports of the probe typed so far
+static uint8_t changes = 0;    // LED changes seen since the probe started
+static uint32_t press_ms;      // when the second press was typed
+
+static bool leds_known = false;
+static uint8_t last_leds;
+
+static void set_interval(uint32_t ms)
+{
+  ms = ms < TYPING_PACE_MIN_MS ? TYPING_PACE_MIN_MS : ms > TYPING_PACE_MAX_MS ? TYPING_PACE_MAX_MS : ms;
+  if (ms != interval_ms)
+  {
+    printf("### TYPING PACE: %lu MS ###\r\n", (unsigned long)ms);
+  }
+  interval_ms = ms;
+}
+
+static void back_off(void)
+{
+  backed_off = true;
+  set_interval(interval_ms * 2);
+}
+
+void typing_pace_init(int task_id)
+{
+  pace_task_id = task_id;
+}
+
+void typing_pace_reset(void)
+{
+  interval_ms = TYPING_PACE_START_MS;
+  keys = 0;
+  disabled = false;
+  echoed = false;
+  timeouts = 0;
+  backed_off = false;
+  probing = false;
+  leds_known = false;
+}
+
+uint32_t typing_pace_interval_ms(void)
+{
+  return interval_ms;
+}
+
+void typing_pace_typed(bool end_of_record)
+{
+  keys++;
+  if (end_of_record && keys >= TYPING_PACE_PROBE_KEYS && !disabled && !probing)
+  {
+    keys = 0;
+    probing = true;
+    probe_sent = 0;
+    changes = 0;
+  }
+}
+
+bool typing_pace_probing(void)
+{
+  return probing && probe_sent < PROBE_REPORTS;
+}
+
+uint8_t typing_pace_probe_key(void)
+{
+  uint8_t n = probe_sent++;
+  if (n == 2)
+  {
+    press_ms = board_millis();
+  }
+  return n % 2 == 0 ? TYPING_PACE_KEY : 0;
+}
+
+uint32_t typing_pace_wait_ms(void)
+{
+  if (!probing || probe_sent < PROBE_REPORTS)
+  {
+    return 0;
+  }
+  uint32_t elapsed_ms = board_millis() - press_ms;
+  if (elapsed_ms < TYPING_PACE_TIMEOUT_MS)
+  {
+    return TYPING_PACE_TIMEOUT_MS - elapsed_ms; // woken early by the LED report
+  }
+
+  probing = false;
+  timeouts++;
+  if (!echoed && timeouts >= TYPING_PACE_TIMEOUTS)
+  {
+    printf("### TYPING PACE: NO LED ECHO FROM THE PC ###\r\n");
+    disabled = true;
+    set_interval(TYPING_PACE_START_MS);
+  }
+  else
+  {
+    back_off();
+  }
+  return 0;
+}
+
+void typing_pace_leds(uint8_t leds)
+{
+  bool changed = leds_known && ((leds ^ last_leds) & TYPING_PACE_LED);
+  leds_known = true;
+  last_leds = leds;
+  if (!probing || !changed || ++changes < 2 || probe_sent < 3)
+  {
+    return;
+  }
+
+  // The PC has handled the second press, and so every key before it
+  uint32_t echo_ms = board_millis() - press_ms;
+  probing = false;
+  echoed = true;
+  timeouts = 0;
+  if (echo_ms > TYPING_PACE_ECHO_MS)
+  {
+    back_off();
+  }
+  else
+  {
+    set_interval(backed_off ? interval_ms - 1 : interval_ms / 2);
+  }
+  sched_wake(pace_task_id);
+}
+
+#endif
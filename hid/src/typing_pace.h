@@ -0,0 +1,133 @@
+#ifndef TYPING_PACE_H_
+#define TYPING_PACE_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Typing pace
+// The PC gives no flow control for typed keys: if the program in front can't keep up, keys queue up on the PC or
+// get lost. With TYPING_PACE=1, the keyboard checks every so often that the PC has caught up, and types as fast as
+// the PC keeps up with instead of at the fixed 10 ms per report that suits the slowest program.
+//
+// A check (probe) is two presses of TYPING_PACE_KEY, typed at the end of a record once TYPING_PACE_PROBE_KEYS keys
+// have been typed since the last one. The PC handles the lock key in order with the keys before it, and sends a LED
+// output report for each toggle, so the second LED change means everything typed so far has been processed. The
+// lock is back to how it was. Typing waits for the LED report, then:
+// - the echo came within TYPING_PACE_ECHO_MS: the interval between reports is shortened by 1 ms, or halved until
+//   the first back off
+// - the echo came late, or not within TYPING_PACE_TIMEOUT_MS: the interval is doubled
+// The interval stays between TYPING_PACE_MIN_MS and TYPING_PACE_MAX_MS. A PC that never echoes (some don't send
+// LED reports for every lock key) is typed to at TYPING_PACE_START_MS after TYPING_PACE_TIMEOUTS probes, without
+// further probes until it is mounted again.
+//
+// With pacing, the keyboard endpoint is polled every 1 ms, so the interval is the only limit on the typing rate.
+
+#ifndef TYPING_PACE
+#define TYPING_PACE 0 // 1: adapt the typing rate to the PC
+#endif
+
+#ifndef TYPING_PACE_KEY
+#define TYPING_PACE_KEY HID_KEY_SCROLL_LOCK // lock key typed by a probe, with its LED below
+#define TYPING_PACE_LED KEYBOARD_LED_SCROLLLOCK
+#endif
+
+#ifndef TYPING_PACE_PROBE_KEYS
+#define TYPING_PACE_PROBE_KEYS 32
+#endif
+
+#ifndef TYPING_PACE_START_MS
+#define TYPING_PACE_START_MS 10 // the rate without pacing
+#endif
+
+#ifndef TYPING_PACE_MIN_MS
+#define TYPING_PACE_MIN_MS 1
+#endif
+
+#ifndef TYPING_PACE_MAX_MS
+#define TYPING_PACE_MAX_MS 100
+#endif
+
+#ifndef TYPING_PACE_ECHO_MS
+#define TYPING_PACE_ECHO_MS 50 // from the last toggle's release to its LED report
+#endif
+
+#ifndef TYPING_PACE_TIMEOUT_MS
+#define TYPING_PACE_TIMEOUT_MS 1000
+#endif
+
+#ifndef TYPING_PACE_TIMEOUTS
+#define TYPING_PACE_TIMEOUTS 3
+#endif
+
+#define KEYBOARD_POLL_MS (TYPING_PACE ? 1 : 10) // bInterval of the keyboard endpoint (usb_descriptors.c)
+
+#if TYPING_PACE
+
+// Wake task_id when the LED report of a probe arrives
+void typing_pace_init(int task_id);
+
+// Start over at TYPING_PACE_START_MS, e.g. with another PC
+void typing_pace_reset(void);
+
+// ms between two keyboard reports
+uint32_t typing_pace_interval_ms(void);
+
+// Count a typed key, at the end of a record or not
+void typing_pace_typed(bool end_of_record);
+
+// Whether a probe has reports left to type
+bool typing_pace_probing(void);
+
+// The key of the probe's next report: TYPING_PACE_KEY for a press, 0 for a release
+uint8_t typing_pace_probe_key(void);
+
+// ms until the probe times out while typing waits for its echo, or 0
+uint32_t typing_pace_wait_ms(void);
+
+// LED output report of the keyboard
+void typing_pace_leds(uint8_t leds);
+
+#else
+
+static inline void typing_pace_init(int task_id)
+{
+  (void)task_id;
+}
+
+static inline void typing_pace_reset(void)
+{
+}
+
+static inline uint32_t typing_pace_interval_ms(void)
+{
+  return 10;
+}
+
+static inline void typing_pace_typed(bool end_of_record)
+{
+  (void)end_of_record;
+}
+
+static inline bool typing_pace_probing(void)
+{
+  return false;
+}
+
+static inline uint8_t typing_pace_probe_key(void)
+{
+  return 0;
+}
+
+static inline uint32_t typing_pace_wait_ms(void)
+{
+  return 0;
+}
+
+static inline void typing_pace_leds(uint8_t leds)
+{
+  (void)leds;
+}
+
+#endif
+
+#endif /* TYPING_PACE_H_ */
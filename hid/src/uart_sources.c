@@ -0,0 +1,172 @@
+#include <string.h>
+
+#include "bsp/board_api.h"
+#include "pico/stdlib.h"
+#include "hardware/uart.h"
+#include "hardware/irq.h"
+#include "uart_sources.h"
+#include "journal.h"
+#include "counters.h"
+#include "sched.h"
+#include "hot_path.h"
+
+#if HID_SOURCES > 1
+#include <assert.h>
+
+#include "hardware/pio.h"
+#include "uart_rx.pio.h"
+
+static uint const source_pins[] = {HID_SOURCE_PINS};
+
+static_assert(HID_SOURCES - 1 <= sizeof(source_pins) / sizeof(source_pins[0]), "a pin is needed for every source");
+static_assert(HID_SOURCES - 1 <= NUM_PIO_STATE_MACHINES, "the PIO sources share one PIO block");
+static_assert(HID_SOURCES <= 9, "the source tag is one digit");
+#endif
+
+// Characters are moved from the FIFOs into a ring per source by the RX interrupts, which also wake the data task
+#define SOURCE_RX_BUFSIZE 256
+
+typedef struct
+{
+  uint8_t rx_buf[SOURCE_RX_BUFSIZE];
+  volatile uint32_t rx_head; // written by the interrupt
+  volatile uint32_t rx_tail; // written by the data task
+
+  uint8_t record[JOURNAL_RECORD_MAX - UART_SOURCES_TAG_LEN];
+  uint32_t record_len;
+  bool record_complete;
+  uint32_t record_ms; // when the end of the record was received
+} source_t;
+
+static source_t sources[HID_SOURCES];
+static uint32_t next_source = 0; // the source whose turn it is
+static int data_task_id = -1;
+
+static void HOT_FUNC(source_rx_put)(source_t *source, uint8_t ch)
+{
+  counters.rx_bytes++;
+  if (source->rx_head - source->rx_tail < SOURCE_RX_BUFSIZE)
+  {
+    source->rx_buf[source->rx_head % SOURCE_RX_BUFSIZE] = ch;
+    source->rx_head++;
+  }
+  else
+  {
+    counters.rx_dropped++;
+  }
+}
+
+static void HOT_FUNC(on_uart_rx)(void)
+{
+  while (uart_is_readable(uart1))
+  {
+    source_rx_put(&sources[0], (uint8_t)uart_getc(uart1));
+  }
+  sched_wake(data_task_id);
+}
+
+#if HID_SOURCES > 1
+static uint pio_sm[HID_SOURCES - 1];
+
+static void HOT_FUNC(on_pio_rx)(void)
+{
+  for (int i = 0; i < HID_SOURCES - 1; i++)
+  {
+    while (!pio_sm_is_rx_fifo_empty(pio0, pio_sm[i]))
+    {
+      source_rx_put(&sources[i + 1], (uint8_t)(pio_sm_get(pio0, pio_sm[i]) >> 24)); // shifted in from the left
+    }
+  }
+  sched_wake(data_task_id);
+}
+
+static void pio_sources_init(uint32_t baud)
+{
+  uint offset = pio_add_program(pio0, &uart_rx_program);
+  for (int i = 0; i < HID_SOURCES - 1; i++)
+  {
+    pio_sm[i] = (uint)pio_claim_unused_sm(pio0, true);
+    uart_rx_program_init(pio0, pio_sm[i], offset, source_pins[i], baud);
+    pio_set_irq0_source_enabled(pio0, (pio_interrupt_source_t)(pis_sm0_rx_fifo_not_empty + pio_sm[i]), true);
+  }
+  irq_set_exclusive_handler(PIO0_IRQ_0, on_pio_rx);
+  irq_set_enabled(PIO0_IRQ_0, true);
+}
+#endif
+
+void uart_sources_init(int task_id, uint32_t baud)
+{
+  data_task_id = task_id;
+
+  irq_set_exclusive_handler(UART1_IRQ, on_uart_rx);
+  irq_set_enabled(UART1_IRQ, true);
+  uart_set_irq_enables(uart1, true, false);
+
+#if HID_SOURCES > 1
+  pio_sources_init(baud);
+#else
+  (void)baud; // uart1 is set up by main()
+#endif
+}
+
+bool uart_sources_available(void)
+{
+  for (int i = 0; i < HID_SOURCES; i++)
+  {
+    if (sources[i].record_complete || sources[i].rx_head != sources[i].rx_tail)
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Move received characters into the source's record. Returns true when it holds a whole record.
+static bool source_collect(source_t *source)
+{
+  while (!source->record_complete && source->rx_head != source->rx_tail)
+  {
+    uint8_t ch = source->rx_buf[source->rx_tail % SOURCE_RX_BUFSIZE];
+    source->rx_tail++;
+    if (source->record_len < sizeof(source->record) - 1 || ch == '\n')
+    {
+      source->record[source->record_len++] = ch; // the last byte is kept for the end of line
+    }
+    if (ch == '\n')
+    {
+      counters.records++;
+      source->record_ms = board_millis();
+      source->record_complete = true;
+    }
+  }
+  return source->record_complete;
+}
+
+uint32_t uart_sources_next_record(uint8_t *data, uint32_t *rx_ms)
+{
+  for (uint32_t n = 0; n < HID_SOURCES; n++)
+  {
+    uint32_t i = (next_source + n) % HID_SOURCES;
+    source_t *source = &sources[i];
+    if (!source_collect(source))
+    {
+      continue;
+    }
+
+    uint32_t len = 0;
+    if (UART_SOURCES_TAG_LEN > 0)
+    {
+      data[len++] = (uint8_t)('1' + i);
+      data[len++] = '\t';
+    }
+    memcpy(&data[len], source->record, source->record_len);
+    len += source->record_len;
+    *rx_ms = source->record_ms;
+
+    source->record_len = 0;
+    source->record_complete = false;
+    next_source = (i + 1) % HID_SOURCES; // the others go first next time
+    return len;
+  }
+  return 0;
+}
@@ -0,0 +1,37 @@
+#ifndef UART_SOURCES_H_
+#define UART_SOURCES_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Record sources
+// Source 1 is the MSC on uart1. With HID_SOURCES set above 1, more MSC boards can be connected, each to one of
+// HID_SOURCE_PINS, where a PIO state machine receives at the same baud rate (uart_rx.pio). Every source has its own
+// RX ring and collects its own record, and the sources take turns: one whole record from each source that has one,
+// so the characters of readings from different meters are never mixed, and a busy meter can't hold up the others.
+//
+// With more than one source, each record starts with its source number and a tab, e.g. "2\t0.037\n". Typed into a
+// spreadsheet, the source lands in one column and the reading in the next.
+
+#ifndef HID_SOURCES
+#define HID_SOURCES 1
+#endif
+
+// RX pins of sources 2 to HID_SOURCES, GP6 to GP8 are physical pins 9 to 11
+#ifndef HID_SOURCE_PINS
+#define HID_SOURCE_PINS 6, 7, 8
+#endif
+
+#define UART_SOURCES_TAG_LEN (HID_SOURCES > 1 ? 2 : 0)
+
+// Start receiving on all the sources. The RX interrupts wake task_id.
+void uart_sources_init(int task_id, uint32_t baud);
+
+// Whether any source has received characters that haven't been taken yet
+bool uart_sources_available(void);
+
+// Take the next whole record, from the sources in turn, into data (JOURNAL_RECORD_MAX bytes).
+// Returns its length, or 0 if no source has a whole record. rx_ms is when the end of the record was received.
+uint32_t uart_sources_next_record(uint8_t *data, uint32_t *rx_ms);
+
+#endif /* UART_SOURCES_H_ */
@@ -25,6 +25,8 @@
 
 #include "bsp/board_api.h"
 #include "tusb.h"
+#include "raw_hid.h"
+#include "typing_pace.h"
 
 /* A combination of interfaces must have a unique product id, since PC will save device driver after the first plug.
  * Same VID/PID with different interface e.g MSC (first), then CDC (later) will possibly cause system error on PC.
@@ -44,9 +46,17 @@ tusb_desc_device_t const desc_device =
     .bLength            = sizeof(tusb_desc_device_t),
     .bDescriptorType    = TUSB_DESC_DEVICE,
     .bcdUSB             = 0x0200,
+
+#if CFG_TUD_CDC
+    // The CDC interfaces are grouped with an Interface Association Descriptor
+    .bDeviceClass       = TUSB_CLASS_MISC,
+    .bDeviceSubClass    = MISC_SUBCLASS_COMMON,
+    .bDeviceProtocol    = MISC_PROTOCOL_IAD,
+#else
     .bDeviceClass       = 0x00,
     .bDeviceSubClass    = 0x00,
     .bDeviceProtocol    = 0x00,
+#endif
     .bMaxPacketSize0    = CFG_TUD_ENDPOINT0_SIZE,
 
     .idVendor           = 0xCafe,
@@ -81,6 +91,24 @@ uint8_t const desc_hid_report2[] =
   TUD_HID_REPORT_DESC_MOUSE()
 };
 
+// Raw HID interface, see raw_hid.h. Every report is 63 bytes after its ID.
+#define RAW_HID_REPORT(id, usage, main_item)  \
+  HID_REPORT_ID(id) HID_USAGE(usage) HID_LOGICAL_MIN(0) HID_LOGICAL_MAX_N(0xff, 2) \
+  HID_REPORT_SIZE(8) HID_REPORT_COUNT(RAW_HID_REPORT_SIZE) main_item(HID_DATA | HID_VARIABLE | HID_ABSOLUTE),
+
+uint8_t const desc_hid_report3[] =
+{
+  HID_USAGE_PAGE_N(HID_USAGE_PAGE_VENDOR, 2),
+  HID_USAGE(0x01),
+  HID_COLLECTION(HID_COLLECTION_APPLICATION),
+    RAW_HID_REPORT(RAW_HID_REPORT_RECORDS, 0x02, HID_INPUT)
+    RAW_HID_REPORT(RAW_HID_REPORT_COUNTERS, 0x03, HID_FEATURE)
+    RAW_HID_REPORT(RAW_HID_REPORT_LATENCY, 0x04, HID_FEATURE)
+    RAW_HID_REPORT(RAW_HID_REPORT_TASKS, 0x05, HID_FEATURE)
+    RAW_HID_REPORT(RAW_HID_REPORT_MODE, 0x06, HID_FEATURE)
+  HID_COLLECTION_END
+};
+
 // Invoked when received GET HID REPORT DESCRIPTOR
 // Application return pointer to descriptor
 // Descriptor contents must exist long enough for transfer to complete
@@ -94,6 +122,10 @@ uint8_t const * tud_hid_descriptor_report_cb(uint8_t itf)
   {
     return desc_hid_report2;
   }
+  else if (itf == RAW_HID_ITF)
+  {
+    return desc_hid_report3;
+  }
 
   return NULL;
 }
@@ -106,13 +138,22 @@ enum
 {
   ITF_NUM_HID1,
   ITF_NUM_HID2,
+  ITF_NUM_HID3,
+#if CFG_TUD_CDC
+  ITF_NUM_CDC,
+  ITF_NUM_CDC_DATA,
+#endif
   ITF_NUM_TOTAL
 };
 
-#define  CONFIG_TOTAL_LEN  (TUD_CONFIG_DESC_LEN + TUD_HID_DESC_LEN + TUD_HID_DESC_LEN)
+#define  CONFIG_TOTAL_LEN  (TUD_CONFIG_DESC_LEN + 3 * TUD_HID_DESC_LEN + CFG_TUD_CDC * TUD_CDC_DESC_LEN)
 
 #define EPNUM_HID1   0x81
 #define EPNUM_HID2   0x82
+#define EPNUM_HID3   0x83
+#define EPNUM_CDC_NOTIF   0x84
+#define EPNUM_CDC_OUT     0x05
+#define EPNUM_CDC_IN      0x85
 
 uint8_t const desc_configuration[] =
 {
@@ -120,8 +161,14 @@ uint8_t const desc_configuration[] =
   TUD_CONFIG_DESCRIPTOR(1, ITF_NUM_TOTAL, 0, CONFIG_TOTAL_LEN, TUSB_DESC_CONFIG_ATT_REMOTE_WAKEUP, 100),
 
   // Interface number, string index, protocol, report descriptor len, EP In address, size & polling interval
-  TUD_HID_DESCRIPTOR(ITF_NUM_HID1, 4, HID_ITF_PROTOCOL_NONE, sizeof(desc_hid_report1), EPNUM_HID1, CFG_TUD_HID_EP_BUFSIZE, 10),
-  TUD_HID_DESCRIPTOR(ITF_NUM_HID2, 5, HID_ITF_PROTOCOL_NONE, sizeof(desc_hid_report2), EPNUM_HID2, CFG_TUD_HID_EP_BUFSIZE, 10)
+  TUD_HID_DESCRIPTOR(ITF_NUM_HID1, 4, HID_ITF_PROTOCOL_NONE, sizeof(desc_hid_report1), EPNUM_HID1, 8, KEYBOARD_POLL_MS),
+  TUD_HID_DESCRIPTOR(ITF_NUM_HID2, 5, HID_ITF_PROTOCOL_NONE, sizeof(desc_hid_report2), EPNUM_HID2, 8, 10),
+  TUD_HID_DESCRIPTOR(ITF_NUM_HID3, 7, HID_ITF_PROTOCOL_NONE, sizeof(desc_hid_report3), EPNUM_HID3, 64, 1),
+
+#if CFG_TUD_CDC
+  // Interface number, string index, EP notification address and size, EP data address (out, in) and size.
+  TUD_CDC_DESCRIPTOR(ITF_NUM_CDC, 6, EPNUM_CDC_NOTIF, 8, EPNUM_CDC_OUT, EPNUM_CDC_IN, 64),
+#endif
 };
 
 // Invoked when received GET CONFIGURATION DESCRIPTOR
@@ -154,6 +201,8 @@ char const *string_desc_arr[] =
   NULL,                           // 3: Serials will use unique ID if possible
   "Keyboard Interface",           // 4: Interface 1 String
   "Mouse Interface",              // 5: Interface 2 String
+  "LIT Serial",                   // 6: CDC Interface
+  "LIT Raw Interface",            // 7: Interface 3 String
 };
 
 static uint16_t _desc_str[32 + 1];
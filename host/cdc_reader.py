@@ -0,0 +1,91 @@
+#!/usr/bin/env python3
+"""Reader for the serial port of the HID board (built with HID_CDC=1, see hid/src/cdc_output.h).
+
+Opening the port sets DTR, which makes the HID send records to the port instead of typing them.
+
+    cdc_reader.py [/dev/ttyACM0]                 print the records as they arrive
+    cdc_reader.py --test [--bytes N] [/dev/ttyACM0]
+                                                 run the throughput test and check the stream
+
+Only the python standard library is used.
+"""
+
+import argparse
+import os
+import sys
+import termios
+import time
+import tty
+
+TEST_LINE_SIZE = 16
+
+
+def open_port(path):
+    fd = os.open(path, os.O_RDWR | os.O_NOCTTY)
+    tty.setraw(fd)
+    attrs = termios.tcgetattr(fd)
+    attrs[2] |= termios.HUPCL  # drop DTR when the port is closed, so the HID goes back to typing
+    termios.tcsetattr(fd, termios.TCSANOW, attrs)
+    termios.tcflush(fd, termios.TCIOFLUSH)
+    return fd
+
+
+def read_records(fd):
+    start = time.monotonic()
+    pending = b""
+    while True:
+        data = os.read(fd, 4096)
+        if not data:
+            return
+        pending += data
+        *lines, pending = pending.split(b"\n")
+        for line in lines:
+            print("%10.3f s  %s" % (time.monotonic() - start, line.decode("ascii", "replace")), flush=True)
+
+
+def throughput_test(fd, total):
+    total -= total % TEST_LINE_SIZE
+    os.write(fd, b"T")
+
+    received = 0
+    line_no = 0
+    pending = b""
+    start = None
+    while received < total:
+        data = os.read(fd, 65536)
+        if start is None:
+            start = time.monotonic()  # from the first data, so the USB latency of the command isn't counted
+        received += len(data)
+        pending += data
+        while len(pending) >= TEST_LINE_SIZE:
+            line, pending = pending[:TEST_LINE_SIZE], pending[TEST_LINE_SIZE:]
+            if line != b"%015d\n" % line_no:
+                sys.exit("stream error at line %d: %r" % (line_no, line))
+            line_no += 1
+    seconds = time.monotonic() - start
+
+    print("%d bytes in %.3f s: %.1f KB/s" % (received, seconds, received / seconds / 1000))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("port", nargs="?", default="/dev/ttyACM0")
+    parser.add_argument("--test", action="store_true", help="run the throughput test")
+    parser.add_argument("--bytes", type=int, default=4 * 1024 * 1024,
+                        help="bytes streamed by the test, must match CDC_TEST_BYTES (default 4 MiB)")
+    args = parser.parse_args()
+
+    fd = open_port(args.port)
+    try:
+        if args.test:
+            throughput_test(fd, args.bytes)
+        else:
+            read_records(fd)
+    except KeyboardInterrupt:
+        pass
+    finally:
+        os.close(fd)
+
+
+if __name__ == "__main__":
+    main()
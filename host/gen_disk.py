@@ -0,0 +1,257 @@
+#!/usr/bin/env python3
+"""Generate the MSC's FAT16 volume (msc/src/disk_image.c) at build time.
+
+Formats an empty FAT16 volume the way mkfs.fat -F 16 does, with the given geometry, label and directories, and
+writes two headers into the output folder:
+
+    disk_geometry.h    the layout macros used by msc/src/disk_layout.h
+    disk_image_data.h  the non-zero sectors, run-length encoded, and an index of them
+
+The root directory entry after the label and the directories is left free for the firmware's CONFIG.TXT
+(msc/src/config_file.c), and its offset in the first root sector is written to disk_geometry.h. So are the label
+and the serial number, which the firmware writes back into the sectors of the first LUN (msc/src/msc_lun.c).
+The time stamp of the entries is written there as well, for the firmware's own entries.
+
+Sectors that are all zeros are not stored. Every stored sector is encoded as a series of runs, each starting with
+a control byte c:
+
+    c < 0x80    c + 1 literal bytes follow
+    c >= 0x80   the next byte is repeated c - 0x80 + 2 times
+
+    gen_disk.py [--sectors N] [--cluster-sectors N] [--label NAME] [--serial N] [--dir NAME ...] [--dir-cluster N]
+                [--hidden-sectors N] OUTPUT_DIR
+
+Only the python standard library is used.
+"""
+
+import argparse
+import datetime
+import os
+import struct
+
+SECTOR_SIZE = 512
+RESERVED_SECTORS = 4
+FAT_NUM = 2
+ROOT_ENTRIES = 512
+MEDIA = 0xF8
+MIN_CLUSTERS = 4085  # fewer clusters would make the volume FAT12
+MAX_CLUSTERS = 65524
+
+# mkfs.fat's boot code, which prints the message when the volume is booted
+BOOT_CODE = bytes([
+    0x0e, 0x1f, 0xbe, 0x5b, 0x7c, 0xac, 0x22, 0xc0, 0x74, 0x0b, 0x56, 0xb4, 0x0e, 0xbb, 0x07, 0x00,
+    0xcd, 0x10, 0x5e, 0xeb, 0xf0, 0x32, 0xe4, 0xcd, 0x16, 0xcd, 0x19, 0xeb, 0xfe,
+]) + b"This is not a bootable disk.  Please insert a bootable floppy and\r\npress any key to try again ... \r\n"
+
+ATTR_VOLUME_ID = 0x08
+ATTR_DIRECTORY = 0x10
+ATTR_LONG_NAME = 0x0F
+
+
+def fat_size(sectors, cluster_sectors, root_sectors):
+    """Sectors per FAT, the smallest that covers every cluster left once the FATs are placed."""
+    fat_sectors = 1
+    while True:
+        data_sectors = sectors - RESERVED_SECTORS - FAT_NUM * fat_sectors - root_sectors
+        clusters = data_sectors // cluster_sectors
+        if (clusters + 2) * 2 <= fat_sectors * SECTOR_SIZE:
+            return fat_sectors, clusters
+        fat_sectors += 1
+
+
+def fat_timestamp(when):
+    time = (when.hour << 11) | (when.minute << 5) | (when.second // 2)
+    date = ((when.year - 1980) << 9) | (when.month << 5) | when.day
+    return time, date
+
+
+def short_name(name):
+    base, _, ext = name.upper().partition(".")
+    return base.ljust(8).encode("ascii") + ext.ljust(3).encode("ascii")
+
+
+def dir_entry(name11, attr, cluster, when):
+    time, date = fat_timestamp(when)
+    return struct.pack("<11sBBBHHHHHHHI", name11, attr, 0, 0, time, date, date, 0, time, date, cluster, 0)
+
+
+def lfn_entries(name, name11):
+    """Long name entries for a name that isn't a valid short name as it is, in on-disk order."""
+    checksum = 0
+    for c in name11:
+        checksum = (((checksum & 1) << 7) + (checksum >> 1) + c) & 0xFF
+    chars = [ord(c) for c in name] + [0]
+    chars += [0xFFFF] * (-len(chars) % 13)
+    entries = []
+    for n in range(len(chars) // 13):
+        part = chars[13 * n:13 * n + 13]
+        seq = n + 1 + (0x40 if n == len(chars) // 13 - 1 else 0)
+        entries.append(struct.pack("<B5HBBB6HH2H", seq, *part[0:5], ATTR_LONG_NAME, 0, checksum, *part[5:11], 0,
+                                   *part[11:13]))
+    return entries[::-1]
+
+
+def format_volume(args):
+    """Returns the geometry and the non-zero sectors of the volume, as a dict of lba to bytes."""
+    root_sectors = ROOT_ENTRIES * 32 // SECTOR_SIZE
+    fat_sectors, clusters = fat_size(args.sectors, args.cluster_sectors, root_sectors)
+    if not MIN_CLUSTERS <= clusters <= MAX_CLUSTERS:
+        raise SystemExit("%d clusters is not a FAT16 volume" % clusters)
+    fat_lba = RESERVED_SECTORS
+    root_lba = fat_lba + FAT_NUM * fat_sectors
+    data_lba = root_lba + root_sectors
+    when = datetime.datetime.strptime(args.time, "%Y-%m-%d %H:%M:%S")
+
+    sectors = {}
+
+    boot = bytearray(SECTOR_SIZE)
+    boot[0:3] = b"\xeb\x3c\x90"
+    boot[3:11] = b"mkfs.fat"
+    small = args.sectors < 0x10000  # then the size goes in the 16 bit field
+    struct.pack_into("<HBHBHHBHHHII", boot, 11, SECTOR_SIZE, args.cluster_sectors, RESERVED_SECTORS, FAT_NUM,
+                     ROOT_ENTRIES, args.sectors if small else 0, MEDIA, fat_sectors, 32, 64, args.hidden_sectors,
+                     0 if small else args.sectors)
+    struct.pack_into("<BBBI11s8s", boot, 36, 0x80, 0x01, 0x29, args.serial, args.label.ljust(11).encode("ascii"),
+                     b"FAT16   ")
+    boot[62:62 + len(BOOT_CODE)] = BOOT_CODE
+    boot[510:512] = b"\x55\xaa"
+    sectors[0] = bytes(boot)
+
+    fat = bytearray(fat_sectors * SECTOR_SIZE)
+    struct.pack_into("<HH", fat, 0, 0xFF00 | MEDIA, 0xFFFF)
+    root = bytearray(root_sectors * SECTOR_SIZE)
+    root_entries = [dir_entry(args.label.ljust(11).encode("ascii"), ATTR_VOLUME_ID, 0, when)]
+
+    cluster = args.dir_cluster
+    for name in args.dir:
+        name11 = short_name(name)
+        if name != name.upper():
+            root_entries += lfn_entries(name, name11)
+        root_entries.append(dir_entry(name11, ATTR_DIRECTORY, cluster, when))
+        struct.pack_into("<H", fat, cluster * 2, 0xFFFF)
+        sectors[data_lba + (cluster - 2) * args.cluster_sectors] = (
+            dir_entry(b".          ", ATTR_DIRECTORY, cluster, when) +
+            dir_entry(b"..         ", ATTR_DIRECTORY, 0, when)).ljust(SECTOR_SIZE, b"\0")
+        cluster += 1
+
+    root[0:32 * len(root_entries)] = b"".join(root_entries)
+    config_offset = 32 * len(root_entries)  # reserved, the firmware fills it in as the host reads it
+    if config_offset + 32 > SECTOR_SIZE:
+        raise SystemExit("the directories leave no room for CONFIG.TXT in the first root sector")
+    for n in range(fat_sectors):
+        for copy in range(FAT_NUM):
+            sectors[fat_lba + copy * fat_sectors + n] = bytes(fat[n * SECTOR_SIZE:(n + 1) * SECTOR_SIZE])
+    for n in range(root_sectors):
+        sectors[root_lba + n] = bytes(root[n * SECTOR_SIZE:(n + 1) * SECTOR_SIZE])
+
+    geometry = {
+        "DISK_BLOCK_NUM": args.sectors,
+        "DISK_SECTORS_PER_CLUSTER": args.cluster_sectors,
+        "DISK_FAT_LBA": fat_lba,
+        "DISK_FAT_SECTORS": fat_sectors,
+        "DISK_FAT_NUM": FAT_NUM,
+        "DISK_ROOT_DIR_SECTORS": root_sectors,
+        "DISK_CONFIG_DIR_OFFSET": config_offset,
+        "DISK_LABEL": '"%s"' % args.label.ljust(11)[:11],
+        "DISK_SERIAL": "0x%08xu" % args.serial,
+        "DISK_FAT_TIME": "0x%04x" % fat_timestamp(when)[0],
+        "DISK_FAT_DATE": "0x%04x" % fat_timestamp(when)[1],
+    }
+    return geometry, {lba: data for lba, data in sectors.items() if any(data)}
+
+
+def rle_encode(data):
+    out = bytearray()
+    literal = bytearray()
+    i = 0
+    while i < len(data):
+        run = 1
+        while i + run < len(data) and data[i + run] == data[i] and run < 129:
+            run += 1
+        if run >= 2:
+            if literal:
+                out += bytes([len(literal) - 1]) + literal
+                literal = bytearray()
+            out += bytes([0x80 + run - 2, data[i]])
+            i += run
+        else:
+            literal.append(data[i])
+            if len(literal) == 128:
+                out += bytes([len(literal) - 1]) + literal
+                literal = bytearray()
+            i += 1
+    if literal:
+        out += bytes([len(literal) - 1]) + literal
+    return bytes(out)
+
+
+def rle_decode(data, offset):
+    out = bytearray()
+    while len(out) < SECTOR_SIZE:
+        c = data[offset]
+        if c < 0x80:
+            out += data[offset + 1:offset + 2 + c]
+            offset += 2 + c
+        else:
+            out += bytes([data[offset + 1]]) * (c - 0x80 + 2)
+            offset += 2
+    return bytes(out)
+
+
+def c_bytes(data, indent="    "):
+    lines = []
+    for i in range(0, len(data), 16):
+        lines.append(indent + ", ".join("0x%02x" % b for b in data[i:i + 16]) + ",")
+    return "\n".join(lines)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("output_dir")
+    parser.add_argument("--sectors", type=int, default=65536, help="size of the volume in 512 byte sectors")
+    parser.add_argument("--cluster-sectors", type=int, default=4, choices=[1, 2, 4, 8, 16, 32, 64])
+    parser.add_argument("--label", default="STANDARD", help="volume label, up to 11 characters")
+    parser.add_argument("--serial", type=lambda s: int(s, 0), default=0x47310B47, help="volume serial number")
+    parser.add_argument("--dir", action="append", default=[], help="directory in the root, 8 characters at most")
+    parser.add_argument("--dir-cluster", type=int, default=2, help="first cluster of the directories")
+    parser.add_argument("--hidden-sectors", type=int, default=0, help="sectors before the volume on a partitioned drive")
+    parser.add_argument("--time", default="2025-11-02 17:19:04", help="time stamp of the entries")
+    args = parser.parse_args()
+
+    geometry, sectors = format_volume(args)
+
+    index = []
+    payload = bytearray()
+    for lba in sorted(sectors):
+        encoded = rle_encode(sectors[lba])
+        assert rle_decode(encoded, 0) == sectors[lba]
+        index.append((lba, len(payload)))
+        payload += encoded
+
+    command = "gen_disk.py --sectors %d --cluster-sectors %d --label %s --serial 0x%08x%s --dir-cluster %d" % (
+        args.sectors, args.cluster_sectors, args.label, args.serial, "".join(" --dir " + d for d in args.dir),
+        args.dir_cluster)
+    if args.hidden_sectors:
+        command += " --hidden-sectors %d" % args.hidden_sectors
+
+    os.makedirs(args.output_dir, exist_ok=True)
+    with open(os.path.join(args.output_dir, "disk_geometry.h"), "w") as f:
+        f.write("// Generated by %s, do not edit\n\n" % command)
+        f.write("#ifndef DISK_GEOMETRY_H_\n#define DISK_GEOMETRY_H_\n\n")
+        for name, value in geometry.items():
+            f.write("#define %s %s\n" % (name, value))
+        f.write("\n#endif /* DISK_GEOMETRY_H_ */\n")
+
+    with open(os.path.join(args.output_dir, "disk_image_data.h"), "w") as f:
+        f.write("// Generated by %s, do not edit\n" % command)
+        f.write("// %d non-zero sectors, %d bytes run-length encoded\n\n" % (len(index), len(payload)))
+        f.write("#define DISK_IMAGE_SECTORS %d\n\n" % len(index))
+        f.write("static const disk_image_index_t HOT_DATA(\"disk_image\") disk_image_index[DISK_IMAGE_SECTORS] = {\n")
+        f.write("\n".join("    {%d, %d}," % entry for entry in index))
+        f.write("\n};\n\n")
+        f.write("static const uint8_t HOT_DATA(\"disk_image\") disk_image_payload[%d] = {\n%s\n};\n" % (
+            len(payload), c_bytes(payload)))
+
+
+if __name__ == "__main__":
+    main()
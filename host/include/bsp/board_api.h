@@ -0,0 +1,16 @@
+// Host stand-in for the TinyUSB board API, used by the HID simulation (host/src/hid_sim.c)
+
+#ifndef HOST_BOARD_API_H_
+#define HOST_BOARD_API_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+void board_init(void);
+void board_init_after_tusb(void) __attribute__((weak));
+uint32_t board_millis(void);
+uint32_t board_button_read(void);
+void board_led_write(bool state);
+
+#endif /* HOST_BOARD_API_H_ */
@@ -0,0 +1,20 @@
+// Host stand-in for the pico sdk flash API, used by the HID simulation (host/src/hid_sim.c)
+// The flash is an array in RAM, mapped at XIP_BASE. It starts erased on every run.
+
+#ifndef HOST_HARDWARE_FLASH_H_
+#define HOST_HARDWARE_FLASH_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define FLASH_PAGE_SIZE (1u << 8)
+#define FLASH_SECTOR_SIZE (1u << 12)
+#define PICO_FLASH_SIZE_BYTES (256u * 1024u)
+
+extern uint8_t sim_flash[PICO_FLASH_SIZE_BYTES];
+#define XIP_BASE ((uintptr_t)sim_flash)
+
+void flash_range_erase(uint32_t flash_offs, size_t count);
+void flash_range_program(uint32_t flash_offs, uint8_t const *data, size_t count);
+
+#endif /* HOST_HARDWARE_FLASH_H_ */
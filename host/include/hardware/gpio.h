@@ -0,0 +1,13 @@
+// Host stand-in for the pico sdk GPIO driver, used by the HID simulation (host/src/hid_sim.c)
+
+#ifndef HOST_HARDWARE_GPIO_H_
+#define HOST_HARDWARE_GPIO_H_
+
+enum gpio_function
+{
+  GPIO_FUNC_UART = 2,
+};
+
+void gpio_set_function(unsigned int gpio, enum gpio_function fn);
+
+#endif /* HOST_HARDWARE_GPIO_H_ */
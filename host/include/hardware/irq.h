@@ -0,0 +1,16 @@
+// Host stand-in for the pico sdk interrupt API, used by the HID simulation (host/src/hid_sim.c)
+
+#ifndef HOST_HARDWARE_IRQ_H_
+#define HOST_HARDWARE_IRQ_H_
+
+#include <stdbool.h>
+
+#define UART0_IRQ 33
+#define UART1_IRQ 34
+
+typedef void (*irq_handler_t)(void);
+
+void irq_set_exclusive_handler(unsigned int num, irq_handler_t handler);
+void irq_set_enabled(unsigned int num, bool enabled);
+
+#endif /* HOST_HARDWARE_IRQ_H_ */
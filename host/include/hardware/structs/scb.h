@@ -0,0 +1,17 @@
+// Host stand-in for the Cortex-M33 system control block, used by the HID simulation (host/src/hid_sim.c)
+
+#ifndef HOST_HARDWARE_STRUCTS_SCB_H_
+#define HOST_HARDWARE_STRUCTS_SCB_H_
+
+#include <stdint.h>
+
+#define M33_SCR_SEVONPEND_BITS 0x00000010
+
+typedef struct
+{
+  volatile uint32_t scr;
+} scb_hw_t;
+
+extern scb_hw_t *const scb_hw;
+
+#endif /* HOST_HARDWARE_STRUCTS_SCB_H_ */
@@ -0,0 +1,14 @@
+// Host stand-in for the pico sdk synchronisation primitives, used by the HID simulation (host/src/hid_sim.c)
+// __wfe() advances the virtual clock to the next simulated interrupt.
+
+#ifndef HOST_HARDWARE_SYNC_H_
+#define HOST_HARDWARE_SYNC_H_
+
+#include <stdint.h>
+
+void __wfe(void);
+void __sev(void);
+uint32_t save_and_disable_interrupts(void);
+void restore_interrupts(uint32_t status);
+
+#endif /* HOST_HARDWARE_SYNC_H_ */
@@ -0,0 +1,22 @@
+// Host stand-in for the pico sdk UART driver, used by the HID simulation (host/src/hid_sim.c)
+// Received bytes come from the simulated serial line instead of the UART RX FIFO.
+
+#ifndef HOST_HARDWARE_UART_H_
+#define HOST_HARDWARE_UART_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef struct uart_inst uart_inst_t;
+
+extern uart_inst_t *const uart0;
+extern uart_inst_t *const uart1;
+
+unsigned int uart_init(uart_inst_t *uart, unsigned int baudrate);
+bool uart_is_readable(uart_inst_t *uart);
+char uart_getc(uart_inst_t *uart);
+void uart_putc_raw(uart_inst_t *uart, char c);
+void uart_puts(uart_inst_t *uart, char const *s);
+void uart_set_irq_enables(uart_inst_t *uart, bool rx_has_data, bool tx_needs_data);
+
+#endif /* HOST_HARDWARE_UART_H_ */
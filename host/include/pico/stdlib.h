@@ -0,0 +1,21 @@
+// Host stand-in for the pico sdk standard library, used by the HID simulation (host/src/hid_sim.c)
+// Time is the simulation's virtual clock.
+
+#ifndef HOST_PICO_STDLIB_H_
+#define HOST_PICO_STDLIB_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "hardware/uart.h"
+#include "hardware/gpio.h"
+
+typedef uint64_t absolute_time_t;
+
+absolute_time_t get_absolute_time(void);
+absolute_time_t make_timeout_time_ms(uint32_t ms);
+uint32_t time_us_32(void);
+uint64_t time_us_64(void);
+bool best_effort_wfe_or_timeout(absolute_time_t timeout_timestamp);
+
+#endif /* HOST_PICO_STDLIB_H_ */
@@ -0,0 +1,92 @@
+// Host stand-in for the TinyUSB device API, used by the HID simulation (host/src/hid_sim.c)
+// Only the parts of the API used by hid/src/main.c are declared. They are implemented by the simulation.
+
+#ifndef HOST_TUSB_H_
+#define HOST_TUSB_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#define BOARD_TUD_RHPORT 0
+
+typedef enum
+{
+  TUSB_ROLE_INVALID = 0,
+  TUSB_ROLE_DEVICE,
+  TUSB_ROLE_HOST,
+} tusb_role_t;
+
+typedef enum
+{
+  TUSB_SPEED_FULL = 0,
+  TUSB_SPEED_LOW = 1,
+  TUSB_SPEED_HIGH = 2,
+  TUSB_SPEED_AUTO = 0xff,
+} tusb_speed_t;
+
+typedef struct
+{
+  tusb_role_t role;
+  tusb_speed_t speed;
+} tusb_rhport_init_t;
+
+typedef enum
+{
+  HID_REPORT_TYPE_INVALID = 0,
+  HID_REPORT_TYPE_INPUT,
+  HID_REPORT_TYPE_OUTPUT,
+  HID_REPORT_TYPE_FEATURE
+} hid_report_type_t;
+
+// Keyboard usage codes (HID usage table, keyboard page)
+#define HID_KEY_NONE 0x00
+#define HID_KEY_A 0x04
+#define HID_KEY_1 0x1E
+#define HID_KEY_2 0x1F
+#define HID_KEY_3 0x20
+#define HID_KEY_4 0x21
+#define HID_KEY_5 0x22
+#define HID_KEY_6 0x23
+#define HID_KEY_7 0x24
+#define HID_KEY_8 0x25
+#define HID_KEY_9 0x26
+#define HID_KEY_0 0x27
+#define HID_KEY_ENTER 0x28
+#define HID_KEY_TAB 0x2B
+#define HID_KEY_MINUS 0x2D
+#define HID_KEY_COMMA 0x36
+#define HID_KEY_PERIOD 0x37
+#define HID_KEY_CAPS_LOCK 0x39
+#define HID_KEY_SCROLL_LOCK 0x47
+#define HID_KEY_NUM_LOCK 0x53
+
+// Bits of the keyboard's LED output report
+#define KEYBOARD_LED_NUMLOCK 0x01
+#define KEYBOARD_LED_CAPSLOCK 0x02
+#define KEYBOARD_LED_SCROLLLOCK 0x04
+
+bool tusb_init(uint8_t rhport, tusb_rhport_init_t const *rh_init);
+
+void tud_task(void);
+bool tud_task_event_ready(void);
+bool tud_mounted(void);
+bool tud_suspended(void);
+bool tud_remote_wakeup(void);
+
+// Device callbacks, implemented by the firmware
+void tud_mount_cb(void);
+void tud_umount_cb(void);
+void tud_suspend_cb(bool remote_wakeup_en);
+void tud_resume_cb(void);
+uint16_t tud_hid_get_report_cb(uint8_t itf, uint8_t report_id, hid_report_type_t report_type, uint8_t *buffer,
+                               uint16_t reqlen);
+void tud_hid_set_report_cb(uint8_t itf, uint8_t report_id, hid_report_type_t report_type, uint8_t const *buffer,
+                           uint16_t bufsize);
+
+bool tud_hid_n_ready(uint8_t instance);
+bool tud_hid_n_report(uint8_t instance, uint8_t report_id, void const *report, uint16_t len);
+bool tud_hid_n_keyboard_report(uint8_t instance, uint8_t report_id, uint8_t modifier, uint8_t const keycode[6]);
+
+#endif /* HOST_TUSB_H_ */
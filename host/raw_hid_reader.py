@@ -0,0 +1,105 @@
+#!/usr/bin/env python3
+"""Reader for the raw HID interface of the HID board (see hid/src/raw_hid.h), through linux hidraw.
+
+    raw_hid_reader.py /dev/hidrawN          take the records, instead of having them typed, and print them
+    raw_hid_reader.py --stats /dev/hidrawN  print the counters, the latency histogram and the task stats
+
+The raw interface is the hidraw device of the board whose report descriptor starts with the vendor usage page
+(the third of its three hidraw devices). Only the python standard library is used.
+"""
+
+import argparse
+import fcntl
+import os
+import select
+import struct
+import time
+
+REPORT_SIZE = 63
+REPORT_RECORDS, REPORT_COUNTERS, REPORT_LATENCY, REPORT_TASKS, REPORT_MODE = 1, 2, 3, 4, 5
+MODE_KEYBOARD, MODE_RECORDS = 0, 1
+LEASE_S = 5
+
+COUNTERS = ["uptime_ms", "rx_bytes", "rx_dropped", "records", "typed", "serial", "raw", "journalled", "replayed"]
+TASKS = ["usb", "led", "hid", "uart_data", "journal", "cdc_test"]
+
+
+def ioc(direction, number, size):
+    return (direction << 30) | (size << 16) | (ord("H") << 8) | number
+
+
+def set_feature(fd, report_id, data):
+    buf = bytearray([report_id]) + bytes(data).ljust(REPORT_SIZE, b"\0")
+    fcntl.ioctl(fd, ioc(3, 0x06, len(buf)), buf)  # HIDIOCSFEATURE
+
+
+def get_feature(fd, report_id):
+    buf = bytearray([report_id]) + bytearray(REPORT_SIZE)
+    fcntl.ioctl(fd, ioc(3, 0x07, len(buf)), buf, True)  # HIDIOCGFEATURE
+    return bytes(buf[1:])
+
+
+def read_records(fd):
+    start = time.monotonic()
+    renewed = 0
+    try:
+        while True:
+            if time.monotonic() - renewed > LEASE_S / 2:
+                set_feature(fd, REPORT_MODE, [MODE_RECORDS, LEASE_S])
+                renewed = time.monotonic()
+            if not select.select([fd], [], [], 0.5)[0]:
+                continue
+            report = os.read(fd, REPORT_SIZE + 1)
+            if report[0] != REPORT_RECORDS:
+                continue
+            off = 2
+            for _ in range(report[1]):
+                length = report[off]
+                record = report[off + 1:off + 1 + length].rstrip(b"\n")
+                print("%10.3f s  %s" % (time.monotonic() - start, record.decode("ascii", "replace")), flush=True)
+                off += 1 + length
+    finally:
+        set_feature(fd, REPORT_MODE, [MODE_KEYBOARD, 0])  # back to typing
+
+
+def print_stats(fd):
+    values = struct.unpack_from("<%dI" % len(COUNTERS), get_feature(fd, REPORT_COUNTERS))
+    for name, value in zip(COUNTERS, values):
+        print("%-12s %u" % (name, value))
+
+    print("latency")
+    buckets = struct.unpack_from("<15I", get_feature(fd, REPORT_LATENCY))
+    for i, count in enumerate(buckets):
+        if count:
+            low = 0 if i == 0 else 1 << (i - 1)
+            high = "" if i == len(buckets) - 1 else "%u" % ((1 << i) - 1)
+            print("  %5u-%-5s ms %u" % (low, high, count))
+
+    report = get_feature(fd, REPORT_TASKS)
+    (elapsed_ms,) = struct.unpack_from("<I", report)
+    print("tasks, over %u ms" % elapsed_ms)
+    for i, name in enumerate(TASKS):
+        max_us, load = struct.unpack_from("<IH", report, 4 + 6 * i)
+        print("  %-10s max %6u us  load %u.%u %%" % (name, max_us, load // 10, load % 10))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("device", help="hidraw device, e.g. /dev/hidraw2")
+    parser.add_argument("--stats", action="store_true", help="print the stats and exit")
+    args = parser.parse_args()
+
+    fd = os.open(args.device, os.O_RDWR)
+    try:
+        if args.stats:
+            print_stats(fd)
+        else:
+            read_records(fd)
+    except KeyboardInterrupt:
+        pass
+    finally:
+        os.close(fd)
+
+
+if __name__ == "__main__":
+    main()
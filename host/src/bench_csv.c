@@ -0,0 +1,368 @@
+// Benchmark of the CSV extraction kernels (msc/src/csv_extract.c)
+//
+// The kernels are run over a corpus of CSV files, each in the ways the MSC uses them:
+//   sector  csv_extract_field on each 512 byte sector on its own, as tud_msc_write10_cb does with FILE_CAPTURE=0
+//   file    csv_extract_field on the whole file at once
+//   scan    csv_scan fed a sector at a time through the whole file, as for ROW=n and STATS=1 with file capture
+//   tail    csv_tail fed a sector at a time, as for ROW=LAST
+// The corpus is made of synthetic CSV files (various row counts, column counts, LF or CRLF line endings, quoted or
+// unquoted fields, comma or semicolon delimiters), plus any captured files given on the command line, such as the
+// sample files in host/corpus. They use the delimiter given with -d, or else the one found in their first line.
+//
+// Usage: bench_csv [-r row] [-c col] [-d delim] [captured_file ...]
+//
+// Reports ns/sector and bytes/cycle. Cycles are read from the CPU time stamp counter where available (x86),
+// otherwise bytes/cycle is reported as 0. The value column shows the field found at row and col, and the newest one
+// of col for tail.
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_CYCLES 1
+#else
+#define HAVE_CYCLES 0
+#endif
+
+#include "csv_extract.h"
+
+#define SECTOR_SIZE 512
+#define MIN_RUN_NS 50000000ull // run each case for at least 50 ms
+
+// Same field as the firmware extracts (ROW and COL in msc_disk.c)
+static int row = 5;
+static int col = 2;
+static uint8_t delim = 0; // found in each captured file if not given
+
+typedef enum
+{
+  MODE_SECTOR,
+  MODE_FILE,
+  MODE_SCAN,
+  MODE_TAIL,
+  MODE_COUNT
+} bench_mode_t;
+
+static char const *const mode_names[MODE_COUNT] = {"sector", "file", "scan", "tail"};
+
+static volatile int32_t sink; // keeps the compiler from optimising the kernel away
+
+//--------------------------------------------------------------------+
+// Corpus
+//--------------------------------------------------------------------+
+
+typedef struct
+{
+  char name[48];
+  uint8_t *data;   // zero padded to a whole number of sectors
+  uint32_t nbytes; // length of the file content
+  uint32_t nsectors;
+  uint8_t delim;
+} bench_case_t;
+
+static bench_case_t cases[64];
+static int case_count = 0;
+
+static void add_case(char const *name, uint8_t const *data, uint32_t nbytes, uint8_t case_delim)
+{
+  if (case_count >= (int)(sizeof(cases) / sizeof(cases[0])))
+  {
+    return;
+  }
+  bench_case_t *c = &cases[case_count++];
+  snprintf(c->name, sizeof(c->name), "%s", name);
+  c->nsectors = (nbytes + SECTOR_SIZE - 1) / SECTOR_SIZE;
+  if (c->nsectors == 0)
+  {
+    c->nsectors = 1;
+  }
+  c->data = calloc(c->nsectors, SECTOR_SIZE);
+  memcpy(c->data, data, nbytes);
+  c->nbytes = nbytes;
+  c->delim = case_delim;
+}
+
+// Build a CSV file in the layout of the instrument: a header row, then one row per measurement
+static void add_synthetic_case(int nrows, int ncols, bool crlf, bool quoted, uint8_t case_delim)
+{
+  size_t cap = (size_t)(nrows + 1) * (size_t)ncols * 32 + 64;
+  char *text = malloc(cap);
+  size_t len = 0;
+  char const *eol = crlf ? "\r\n" : "\n";
+  char const *q = quoted ? "\"" : "";
+
+  for (int c = 0; c < ncols; c++)
+  {
+    len += (size_t)snprintf(text + len, cap - len, "%.*s%sCol %d%s", c ? 1 : 0, (char const *)&case_delim, q, c, q);
+  }
+  len += (size_t)snprintf(text + len, cap - len, "%s", eol);
+
+  for (int r = 0; r < nrows; r++)
+  {
+    for (int c = 0; c < ncols; c++)
+    {
+      if (c == 0)
+      {
+        len += (size_t)snprintf(text + len, cap - len, "%s2025-11-04 10:%02d:%02d%s", q, (r / 60) % 60, r % 60, q);
+      }
+      else
+      {
+        // A semicolon file has decimal commas, as exported in European locales
+        char point = case_delim == ';' ? ',' : '.';
+        len += (size_t)snprintf(text + len, cap - len, "%c%s%d%c%03d%s", case_delim, q, c, point,
+                                (r * 37 + c) % 1000, q);
+      }
+    }
+    len += (size_t)snprintf(text + len, cap - len, "%s", eol);
+  }
+
+  char name[48];
+  snprintf(name, sizeof(name), "synth %dx%d %s%s%s", nrows, ncols, crlf ? "crlf" : "lf", quoted ? " quoted" : "",
+           case_delim == ';' ? " semicolon" : "");
+  add_case(name, (uint8_t const *)text, (uint32_t)len, case_delim);
+  free(text);
+}
+
+static bool add_file_case(char const *path)
+{
+  FILE *f = fopen(path, "rb");
+  if (!f)
+  {
+    perror(path);
+    return false;
+  }
+  fseek(f, 0, SEEK_END);
+  long size = ftell(f);
+  fseek(f, 0, SEEK_SET);
+  uint8_t *data = malloc(size > 0 ? (size_t)size : 1);
+  size_t nread = fread(data, 1, (size_t)size, f);
+  fclose(f);
+
+  uint8_t file_delim = delim;
+  for (size_t i = 0; i < nread && !file_delim && data[i] != '\n'; i++)
+  {
+    if (data[i] == ',' || data[i] == ';' || data[i] == '\t')
+    {
+      file_delim = data[i];
+    }
+  }
+
+  char const *base = strrchr(path, '/');
+  add_case(base ? base + 1 : path, data, (uint32_t)nread, file_delim ? file_delim : ',');
+  free(data);
+  return true;
+}
+
+//--------------------------------------------------------------------+
+// Timing
+//--------------------------------------------------------------------+
+
+static uint64_t now_ns(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static uint64_t now_cycles(void)
+{
+#if HAVE_CYCLES
+  return __rdtsc();
+#else
+  return 0;
+#endif
+}
+
+// The field found by a pass, for the report
+typedef struct
+{
+  int32_t len; // -1 if not found
+  uint8_t text[CSV_SCAN_FIELD_MAX];
+} bench_value_t;
+
+static void set_value(bench_value_t *value, uint8_t const *field, uint32_t len)
+{
+  value->len = (int32_t)(len < sizeof(value->text) ? len : sizeof(value->text));
+  memcpy(value->text, field, (size_t)value->len);
+}
+
+static void scan_cb(void *ctx, uint32_t scan_row, uint8_t const *field, uint32_t len, bool truncated)
+{
+  (void)truncated;
+  bench_value_t *value = ctx;
+  if (scan_row == (uint32_t)row && value->len < 0)
+  {
+    set_value(value, field, len);
+  }
+  sink = (int32_t)len;
+}
+
+// Bytes of the file in sector s, the last one cut to size as file_capture_done_cb passes it on
+static uint32_t sector_len(bench_case_t const *c, uint32_t s)
+{
+  uint32_t left = c->nbytes - s * SECTOR_SIZE;
+  return left < SECTOR_SIZE ? left : SECTOR_SIZE;
+}
+
+// One pass of the corpus case
+static void run_case(bench_case_t const *c, bench_mode_t mode, bench_value_t *value)
+{
+  static csv_scan_t scan;
+  static csv_tail_t tail;
+  uint8_t const *field;
+  int32_t len;
+  value->len = -1;
+
+  switch (mode)
+  {
+  case MODE_SECTOR: // one write10 call per sector
+    for (uint32_t s = 0; s < c->nsectors; s++)
+    {
+      len = csv_extract_field(c->data + s * SECTOR_SIZE, SECTOR_SIZE, row, col, c->delim, &field);
+      if (len >= 0 && value->len < 0)
+      {
+        set_value(value, field, (uint32_t)len);
+      }
+      sink = len;
+    }
+    break;
+
+  case MODE_FILE:
+    len = csv_extract_field(c->data, c->nbytes, row, col, c->delim, &field);
+    if (len >= 0)
+    {
+      set_value(value, field, (uint32_t)len);
+    }
+    sink = len;
+    break;
+
+  case MODE_SCAN:
+    csv_scan_init(&scan, c->delim, (uint16_t)col);
+    for (uint32_t s = 0; s < c->nsectors; s++)
+    {
+      csv_scan_feed(&scan, c->data + s * SECTOR_SIZE, sector_len(c, s), scan_cb, value);
+    }
+    csv_scan_end(&scan, scan_cb, value);
+    break;
+
+  case MODE_TAIL:
+    csv_tail_init(&tail, c->delim, (uint16_t)col, 1);
+    for (uint32_t s = 0; s < c->nsectors; s++)
+    {
+      csv_tail_feed(&tail, c->data + s * SECTOR_SIZE, sector_len(c, s));
+    }
+    csv_tail_end(&tail);
+    if (csv_tail_count(&tail) > 0)
+    {
+      csv_tail_field_t const *newest = csv_tail_field(&tail, 0);
+      set_value(value, newest->field, newest->len);
+    }
+    break;
+
+  default:
+    break;
+  }
+}
+
+static void bench_case(bench_case_t const *c, bench_mode_t mode)
+{
+  // Warm up caches and find the extracted value for the report
+  bench_value_t value;
+  run_case(c, mode, &value);
+
+  uint64_t iterations = 0;
+  uint64_t t0 = now_ns();
+  uint64_t c0 = now_cycles();
+  uint64_t t1;
+  do
+  {
+    bench_value_t ignored;
+    for (int i = 0; i < 64; i++)
+    {
+      run_case(c, mode, &ignored);
+    }
+    iterations += 64;
+    t1 = now_ns();
+  } while (t1 - t0 < MIN_RUN_NS);
+  uint64_t c1 = now_cycles();
+
+  double sectors = (double)iterations * c->nsectors;
+  double bytes = sectors * SECTOR_SIZE;
+  double ns_per_sector = (double)(t1 - t0) / sectors;
+  double bytes_per_cycle = (c1 > c0) ? bytes / (double)(c1 - c0) : 0.0;
+
+  char text[32] = "-";
+  if (value.len >= 0)
+  {
+    snprintf(text, sizeof(text), "%.*s", (int)(value.len < 24 ? value.len : 24), (char const *)value.text);
+  }
+
+  printf("%-36s %-6s %8u %8u %12.1f %12.3f  %s\n", c->name, mode_names[mode], c->nsectors, c->nbytes, ns_per_sector,
+         bytes_per_cycle, text);
+}
+
+/*------------- MAIN -------------*/
+int main(int argc, char **argv)
+{
+  int i = 1;
+  for (; i < argc; i++)
+  {
+    if (strcmp(argv[i], "-r") == 0 && i + 1 < argc)
+    {
+      row = atoi(argv[++i]);
+    }
+    else if (strcmp(argv[i], "-c") == 0 && i + 1 < argc)
+    {
+      col = atoi(argv[++i]);
+    }
+    else if (strcmp(argv[i], "-d") == 0 && i + 1 < argc)
+    {
+      i++;
+      delim = strcmp(argv[i], "TAB") == 0 ? '\t' : (uint8_t)argv[i][0];
+    }
+    else
+    {
+      break;
+    }
+  }
+
+  static int const row_counts[] = {5, 20, 100, 1000};
+  static int const col_counts[] = {3, 8};
+  for (size_t r = 0; r < sizeof(row_counts) / sizeof(row_counts[0]); r++)
+  {
+    for (size_t c = 0; c < sizeof(col_counts) / sizeof(col_counts[0]); c++)
+    {
+      add_synthetic_case(row_counts[r], col_counts[c], false, false, ',');
+      add_synthetic_case(row_counts[r], col_counts[c], true, false, ',');
+      add_synthetic_case(row_counts[r], col_counts[c], false, true, ',');
+      add_synthetic_case(row_counts[r], col_counts[c], true, true, ';');
+    }
+  }
+
+  // Captured files, e.g. a CSV file saved by the instrument to a real flash drive
+  for (; i < argc; i++)
+  {
+    if (!add_file_case(argv[i]))
+    {
+      return 1;
+    }
+  }
+
+  printf("extracting row %d, column %d%s\n", row, col, HAVE_CYCLES ? "" : " (no cycle counter, bytes/cycle not measured)");
+  printf("%-36s %-6s %8s %8s %12s %12s  %s\n", "case", "kernel", "sectors", "bytes", "ns/sector", "bytes/cycle",
+         "value");
+  for (int c = 0; c < case_count; c++)
+  {
+    for (int mode = 0; mode < MODE_COUNT; mode++)
+    {
+      bench_case(&cases[c], (bench_mode_t)mode);
+    }
+    free(cases[c].data);
+  }
+  return 0;
+}
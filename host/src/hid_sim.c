@@ -0,0 +1,735 @@
+// Simulation of the HID typing pipeline (hid/src/main.c) on a host PC
+//
+// The firmware's main() is compiled unchanged against the stand-in headers in host/include, and is run on a
+// virtual clock. Every call to tud_task() (once per main loop iteration) advances the clock by a fixed step.
+// A simulated serial line delivers the input byte stream into a 32 byte UART RX FIFO at the configured baud rate,
+// and a fake HID endpoint completes one queued report per host poll interval, like an interrupt IN endpoint.
+//
+// The firmware sleeps in __wfe() between events, so __wfe() and best_effort_wfe_or_timeout() run the clock forward
+// until the next simulated interrupt (a byte received with the UART RX interrupt enabled, or a completed report).
+//
+// The PC can be attached late (-a), to show records being journalled to the simulated flash and replayed on mount.
+// With -r, a PC program switches the raw HID interface to records mode when the device is mounted.
+// With -k, the program in front takes that long to handle each key. Keys queue up on the PC behind it, and the PC
+// sends the LED report of a lock key once the program has got to it, which is what TYPING_PACE=1 (typing_pace.h)
+// adapts the typing rate to.
+//
+// Usage: hid_sim [-b baud] [-p poll_ms] [-l loop_us] [-a attach_ms] [-r] [-k key_us] [-s string | file]
+//
+// Every keyboard report that reaches the host is printed with its delivery time, followed by a summary with the
+// typing throughput. The output only depends on the input and the options, so it can be compared between builds.
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bsp/board_api.h"
+#include "tusb.h"
+#include "pico/stdlib.h"
+#include "hardware/uart.h"
+#include "hardware/gpio.h"
+#include "hardware/irq.h"
+#include "hardware/sync.h"
+#include "hardware/structs/scb.h"
+#include "hardware/flash.h"
+#include "raw_hid.h"
+#include "counters.h"
+#include "typing_pace.h"
+
+int hid_main(void); // main() of hid/src/main.c, renamed at compile time
+
+#define UART_FIFO_DEPTH 32 // RX FIFO depth of the RP2350 UART
+#define HID_INSTANCES 3 // keyboard, mouse, raw
+#define IDLE_EXIT_US 1000000 // stop after 1 s without activity once the input is consumed
+#define MAX_SIM_US (3600ull * 1000000ull)
+#define LED_REPORTS 4 // LED output reports the PC has queued
+
+//--------------------------------------------------------------------+
+// Simulation state
+//--------------------------------------------------------------------+
+
+static uint32_t baud = 9600;
+static uint32_t poll_ms = KEYBOARD_POLL_MS; // bInterval of the keyboard and mouse endpoints in usb_descriptors.c
+static uint32_t loop_us = 20; // virtual duration of one main loop iteration
+static uint64_t attach_us = 0; // the PC mounts the device at this time
+static bool mounted = false;
+static bool raw_mode = false; // -r
+static uint32_t key_us = 0;    // -k, time the PC program takes to handle a key
+
+static uint64_t now_us = 0;
+static uint64_t last_activity_us = 0;
+
+static uint8_t const *input;
+static size_t input_len;
+static size_t input_pos;
+static uint64_t next_byte_us;
+
+static uint8_t rx_fifo[UART_FIFO_DEPTH];
+static uint32_t rx_head, rx_count;
+
+static irq_handler_t uart1_handler;
+static bool uart1_irq_enabled;
+static bool uart1_rx_irq_enabled;
+
+static bool event_flag = false; // event register, set by every simulated interrupt
+static bool usb_event = false;  // TinyUSB has an event queued for tud_task()
+
+typedef struct
+{
+  bool busy;
+  uint8_t report[64];
+  uint16_t len;
+} sim_endpoint_t;
+
+static sim_endpoint_t endpoints[HID_INSTANCES];
+static uint64_t last_frame_ms = 0;
+
+// The PC handles the keys in order, one every key_us. It sends a LED report when it gets to a lock key.
+static uint64_t pc_busy_until_us = 0;
+static uint8_t pc_leds = 0;
+static struct
+{
+  uint64_t due_us;
+  uint8_t leds;
+} led_reports[LED_REPORTS];
+static uint32_t led_reports_queued = 0;
+
+uint8_t sim_flash[PICO_FLASH_SIZE_BYTES];
+
+static struct
+{
+  uint32_t bytes_in;
+  uint32_t bytes_dropped;
+  uint32_t reports;
+  uint32_t reports_rejected;
+  uint32_t keys;
+  uint32_t lock_keys;
+  uint64_t max_lag_us; // keys waiting for the PC program
+  uint32_t flash_pages;
+  uint32_t flash_sectors;
+  uint64_t first_key_us;
+  uint64_t last_key_us;
+} stats;
+
+//--------------------------------------------------------------------+
+// Output
+//--------------------------------------------------------------------+
+
+static char key_char(uint8_t key)
+{
+  if (key >= HID_KEY_1 && key <= HID_KEY_9)
+  {
+    return (char)('1' + key - HID_KEY_1);
+  }
+  switch (key)
+  {
+  case HID_KEY_0:
+    return '0';
+  case HID_KEY_PERIOD:
+    return '.';
+  case HID_KEY_COMMA:
+    return ',';
+  case HID_KEY_MINUS:
+    return '-';
+  case HID_KEY_ENTER:
+    return '\n';
+  case HID_KEY_TAB:
+    return '\t';
+  default:
+    return '?';
+  }
+}
+
+static void print_report(uint8_t instance, sim_endpoint_t const *ep)
+{
+  printf("%10.3f ms  itf %u ", (double)now_us / 1000.0, instance);
+  for (uint16_t i = 0; i < ep->len; i++)
+  {
+    printf(" %02x", ep->report[i]);
+  }
+
+  if (instance == RAW_HID_ITF && ep->len > 1)
+  {
+    // Records report: ID, count, then length prefixed records
+    printf("  %u records:", ep->report[1]);
+    uint16_t off = 2;
+    for (uint8_t n = 0; n < ep->report[1] && off < ep->len; n++)
+    {
+      int n = ep->report[off];
+      if (n > 0 && ep->report[off + n] == '\n')
+      {
+        n--; // the end of line
+      }
+      printf(" '%.*s'", n, (char const *)&ep->report[off + 1]);
+      off = (uint16_t)(off + 1 + ep->report[off]);
+    }
+  }
+  else if (instance == 0 && ep->len == 8)
+  {
+    uint8_t key = ep->report[2];
+    if (key == 0)
+    {
+      printf("  release");
+    }
+    else
+    {
+      char c = key_char(key);
+      if (key == HID_KEY_SCROLL_LOCK)
+      {
+        printf("  press SCROLL LOCK");
+      }
+      else if (c == '\n')
+      {
+        printf("  press ENTER");
+      }
+      else
+      {
+        printf("  press '%c'", c);
+      }
+    }
+  }
+  printf("\n");
+}
+
+static void print_summary(void)
+{
+  printf("--\n");
+  printf("bytes in        %u\n", stats.bytes_in);
+  printf("bytes dropped   %u (UART RX FIFO overflow)\n", stats.bytes_dropped);
+  printf("reports         %u\n", stats.reports);
+  printf("reports refused %u (endpoint busy)\n", stats.reports_rejected);
+  printf("keys typed      %u\n", stats.keys);
+  if (stats.lock_keys)
+  {
+    printf("lock keys       %u\n", stats.lock_keys);
+  }
+  if (key_us)
+  {
+    printf("PC lag          %.3f ms max\n", (double)stats.max_lag_us / 1000.0);
+  }
+  printf("flash programs  %u pages, %u sector erases\n", stats.flash_pages, stats.flash_sectors);
+  if (stats.keys > 1)
+  {
+    double seconds = (double)(stats.last_key_us - stats.first_key_us) / 1e6;
+    printf("typing time     %.3f s\n", seconds);
+    printf("throughput      %.1f keys/s\n", (double)(stats.keys - 1) / seconds);
+  }
+
+  // Read back through the feature reports, like a PC program would
+  uint8_t buf[RAW_HID_REPORT_SIZE];
+  if (tud_hid_get_report_cb(RAW_HID_ITF, RAW_HID_REPORT_COUNTERS, HID_REPORT_TYPE_FEATURE, buf, sizeof(buf)))
+  {
+    uint32_t c[1 + sizeof(counters_t) / 4];
+    memcpy(c, buf, sizeof(c)); // little endian, like the host
+    printf("records         %u received, %u typed, %u raw, %u serial, %u journalled, %u replayed\n", c[3], c[4],
+           c[6], c[5], c[7], c[8]);
+    printf("ring dropped    %u bytes (UART RX ring overflow)\n", c[2]);
+  }
+  if (tud_hid_get_report_cb(RAW_HID_ITF, RAW_HID_REPORT_LATENCY, HID_REPORT_TYPE_FEATURE, buf, sizeof(buf)))
+  {
+    printf("latency         ");
+    for (int i = 0; i < COUNTERS_LATENCY_BUCKETS; i++)
+    {
+      uint32_t count;
+      memcpy(&count, &buf[4 * i], 4);
+      if (count)
+      {
+        printf(" <%ums:%u", 1u << i, count);
+      }
+    }
+    printf("\n");
+  }
+}
+
+//--------------------------------------------------------------------+
+// Virtual clock
+//--------------------------------------------------------------------+
+
+// Deliver the bytes that finished arriving on the serial line
+static void uart_line_step(void)
+{
+  while (input_pos < input_len && next_byte_us <= now_us)
+  {
+    stats.bytes_in++;
+    if (rx_count < UART_FIFO_DEPTH)
+    {
+      rx_fifo[(rx_head + rx_count) % UART_FIFO_DEPTH] = input[input_pos];
+      rx_count++;
+    }
+    else
+    {
+      stats.bytes_dropped++;
+    }
+    input_pos++;
+    next_byte_us += 10ull * 1000000ull / baud; // start + 8 data + stop bits
+    last_activity_us = now_us;
+
+    if (uart1_handler && uart1_irq_enabled && uart1_rx_irq_enabled)
+    {
+      event_flag = true;
+      uart1_handler();
+    }
+  }
+}
+
+// A key press reaches the PC, and waits behind the keys before it
+static void pc_key(uint8_t key)
+{
+  pc_busy_until_us = (pc_busy_until_us > now_us ? pc_busy_until_us : now_us) + key_us;
+  if (pc_busy_until_us - now_us > stats.max_lag_us)
+  {
+    stats.max_lag_us = pc_busy_until_us - now_us;
+  }
+  if (key != HID_KEY_SCROLL_LOCK)
+  {
+    return;
+  }
+  stats.lock_keys++;
+  pc_leds ^= KEYBOARD_LED_SCROLLLOCK;
+  if (led_reports_queued < LED_REPORTS)
+  {
+    led_reports[led_reports_queued].due_us = pc_busy_until_us;
+    led_reports[led_reports_queued].leds = pc_leds;
+    led_reports_queued++;
+  }
+}
+
+// Send the LED reports that are due, through tud_task() as SET_REPORT requests
+static void pc_send_led_reports(void)
+{
+  while (led_reports_queued > 0 && led_reports[0].due_us <= now_us)
+  {
+    uint8_t leds = led_reports[0].leds;
+    printf("%10.3f ms  LED report %02x\n", (double)now_us / 1000.0, leds);
+    led_reports_queued--;
+    memmove(&led_reports[0], &led_reports[1], led_reports_queued * sizeof(led_reports[0]));
+    tud_hid_set_report_cb(0, 0, HID_REPORT_TYPE_OUTPUT, &leds, 1);
+  }
+}
+
+// Start of a 1 ms USB frame: the host polls endpoints that are due
+static void usb_frame(uint64_t frame_ms)
+{
+  for (uint8_t i = 0; i < HID_INSTANCES; i++)
+  {
+    sim_endpoint_t *ep = &endpoints[i];
+    uint32_t interval_ms = i == RAW_HID_ITF ? 1 : poll_ms; // bInterval in usb_descriptors.c
+    if (!ep->busy || frame_ms % interval_ms != 0)
+    {
+      continue;
+    }
+    print_report(i, ep);
+    stats.reports++;
+    if (i == 0 && ep->len == 8 && ep->report[2] != 0)
+    {
+      pc_key(ep->report[2]);
+    }
+    if (i == 0 && ep->len == 8 && ep->report[2] != 0 && ep->report[2] != HID_KEY_SCROLL_LOCK)
+    {
+      if (stats.keys == 0)
+      {
+        stats.first_key_us = now_us;
+      }
+      stats.keys++;
+      stats.last_key_us = now_us;
+    }
+    ep->busy = false;
+    last_activity_us = now_us;
+    usb_event = true; // transfer complete interrupt
+    event_flag = true;
+  }
+}
+
+static void sim_step(void)
+{
+  now_us += loop_us;
+
+  uint64_t frame_ms = now_us / 1000;
+  while (last_frame_ms < frame_ms)
+  {
+    last_frame_ms++;
+    usb_frame(last_frame_ms);
+  }
+
+  uart_line_step();
+
+  if (led_reports_queued > 0 && led_reports[0].due_us <= now_us)
+  {
+    usb_event = true; // control request
+    event_flag = true;
+  }
+
+  if (!mounted && now_us >= attach_us)
+  {
+    usb_event = true; // bus reset and enumeration, tud_task() invokes tud_mount_cb()
+    event_flag = true;
+  }
+
+  bool idle = mounted && input_pos >= input_len && rx_count == 0 && led_reports_queued == 0;
+  for (uint8_t i = 0; i < HID_INSTANCES; i++)
+  {
+    idle = idle && !endpoints[i].busy;
+  }
+  if ((idle && now_us - last_activity_us > IDLE_EXIT_US) || now_us > MAX_SIM_US)
+  {
+    print_summary();
+    exit(0);
+  }
+}
+
+//--------------------------------------------------------------------+
+// Stand-in API
+//--------------------------------------------------------------------+
+
+struct uart_inst
+{
+  int index;
+};
+
+static scb_hw_t scb;
+scb_hw_t *const scb_hw = &scb;
+
+static struct uart_inst uart_instances[2] = {{0}, {1}};
+uart_inst_t *const uart0 = &uart_instances[0];
+uart_inst_t *const uart1 = &uart_instances[1];
+
+void board_init(void)
+{
+}
+
+uint32_t board_millis(void)
+{
+  return (uint32_t)(now_us / 1000);
+}
+
+uint32_t board_button_read(void)
+{
+  return 0;
+}
+
+void board_led_write(bool state)
+{
+  (void)state;
+}
+
+void gpio_set_function(unsigned int gpio, enum gpio_function fn)
+{
+  (void)gpio;
+  (void)fn;
+}
+
+unsigned int uart_init(uart_inst_t *uart, unsigned int baudrate)
+{
+  (void)uart;
+  return baudrate;
+}
+
+bool uart_is_readable(uart_inst_t *uart)
+{
+  return uart == uart1 && rx_count > 0;
+}
+
+char uart_getc(uart_inst_t *uart)
+{
+  // The real uart_getc blocks until a byte arrives
+  while (!uart_is_readable(uart))
+  {
+    sim_step();
+  }
+  char c = (char)rx_fifo[rx_head];
+  rx_head = (rx_head + 1) % UART_FIFO_DEPTH;
+  rx_count--;
+  return c;
+}
+
+void uart_putc_raw(uart_inst_t *uart, char c)
+{
+  (void)uart;
+  (void)c;
+}
+
+void uart_puts(uart_inst_t *uart, char const *s)
+{
+  (void)uart;
+  (void)s;
+}
+
+void uart_set_irq_enables(uart_inst_t *uart, bool rx_has_data, bool tx_needs_data)
+{
+  (void)tx_needs_data;
+  if (uart == uart1)
+  {
+    uart1_rx_irq_enabled = rx_has_data;
+  }
+}
+
+void irq_set_exclusive_handler(unsigned int num, irq_handler_t handler)
+{
+  if (num == UART1_IRQ)
+  {
+    uart1_handler = handler;
+  }
+}
+
+void irq_set_enabled(unsigned int num, bool enabled)
+{
+  if (num == UART1_IRQ)
+  {
+    uart1_irq_enabled = enabled;
+  }
+}
+
+uint32_t save_and_disable_interrupts(void)
+{
+  return 0;
+}
+
+void restore_interrupts(uint32_t status)
+{
+  (void)status;
+}
+
+void flash_range_erase(uint32_t flash_offs, size_t count)
+{
+  memset(&sim_flash[flash_offs], 0xff, count);
+  stats.flash_sectors += (uint32_t)(count / FLASH_SECTOR_SIZE);
+}
+
+void flash_range_program(uint32_t flash_offs, uint8_t const *data, size_t count)
+{
+  // Programming can only clear bits
+  for (size_t i = 0; i < count; i++)
+  {
+    sim_flash[flash_offs + i] &= data[i];
+  }
+  stats.flash_pages += (uint32_t)(count / FLASH_PAGE_SIZE);
+}
+
+absolute_time_t get_absolute_time(void)
+{
+  return now_us;
+}
+
+absolute_time_t make_timeout_time_ms(uint32_t ms)
+{
+  return now_us + (uint64_t)ms * 1000;
+}
+
+uint32_t time_us_32(void)
+{
+  return (uint32_t)now_us;
+}
+
+uint64_t time_us_64(void)
+{
+  return now_us;
+}
+
+void __sev(void)
+{
+  event_flag = true;
+}
+
+void __wfe(void)
+{
+  while (!event_flag)
+  {
+    sim_step();
+  }
+  event_flag = false;
+}
+
+bool best_effort_wfe_or_timeout(absolute_time_t timeout_timestamp)
+{
+  while (!event_flag && now_us < timeout_timestamp)
+  {
+    sim_step();
+  }
+  event_flag = false;
+  return now_us >= timeout_timestamp;
+}
+
+bool tusb_init(uint8_t rhport, tusb_rhport_init_t const *rh_init)
+{
+  (void)rhport;
+  (void)rh_init;
+  return true;
+}
+
+// Called once per main loop iteration, so this is where the virtual clock ticks
+void tud_task(void)
+{
+  usb_event = false;
+  sim_step();
+  if (!mounted && now_us >= attach_us)
+  {
+    mounted = true;
+    printf("%10.3f ms  mounted\n", (double)now_us / 1000.0);
+    tud_mount_cb();
+    tud_hid_set_report_cb(0, 0, HID_REPORT_TYPE_OUTPUT, &pc_leds, 1); // the PC sets the LEDs at enumeration
+    if (raw_mode)
+    {
+      uint8_t const mode[2] = {RAW_HID_MODE_RECORDS, 0};
+      tud_hid_set_report_cb(RAW_HID_ITF, RAW_HID_REPORT_MODE, HID_REPORT_TYPE_FEATURE, mode, sizeof(mode));
+    }
+  }
+  if (mounted)
+  {
+    pc_send_led_reports();
+  }
+}
+
+bool tud_task_event_ready(void)
+{
+  return usb_event;
+}
+
+bool tud_mounted(void)
+{
+  return mounted;
+}
+
+bool tud_suspended(void)
+{
+  return false;
+}
+
+bool tud_remote_wakeup(void)
+{
+  return false;
+}
+
+bool tud_hid_n_ready(uint8_t instance)
+{
+  return mounted && instance < HID_INSTANCES && !endpoints[instance].busy;
+}
+
+bool tud_hid_n_report(uint8_t instance, uint8_t report_id, void const *report, uint16_t len)
+{
+  if (!tud_hid_n_ready(instance))
+  {
+    stats.reports_rejected++;
+    return false;
+  }
+
+  sim_endpoint_t *ep = &endpoints[instance];
+  ep->len = 0;
+  if (report_id)
+  {
+    ep->report[ep->len++] = report_id;
+  }
+  if (len > sizeof(ep->report) - ep->len)
+  {
+    len = (uint16_t)(sizeof(ep->report) - ep->len);
+  }
+  if (report)
+  {
+    memcpy(ep->report + ep->len, report, len);
+  }
+  else
+  {
+    memset(ep->report + ep->len, 0, len);
+  }
+  ep->len = (uint16_t)(ep->len + len);
+  ep->busy = true;
+  return true;
+}
+
+bool tud_hid_n_keyboard_report(uint8_t instance, uint8_t report_id, uint8_t modifier, uint8_t const keycode[6])
+{
+  uint8_t report[8] = {modifier, 0};
+  if (keycode)
+  {
+    memcpy(report + 2, keycode, 6);
+  }
+  return tud_hid_n_report(instance, report_id, report, sizeof(report));
+}
+
+//--------------------------------------------------------------------+
+// MAIN
+//--------------------------------------------------------------------+
+
+static uint8_t *read_file(char const *path, size_t *len)
+{
+  FILE *f = strcmp(path, "-") == 0 ? stdin : fopen(path, "rb");
+  if (!f)
+  {
+    perror(path);
+    return NULL;
+  }
+  size_t cap = 4096;
+  uint8_t *data = malloc(cap);
+  *len = 0;
+  size_t n;
+  while ((n = fread(data + *len, 1, cap - *len, f)) > 0)
+  {
+    *len += n;
+    if (*len == cap)
+    {
+      cap *= 2;
+      data = realloc(data, cap);
+    }
+  }
+  if (f != stdin)
+  {
+    fclose(f);
+  }
+  return data;
+}
+
+int main(int argc, char **argv)
+{
+  for (int i = 1; i < argc; i++)
+  {
+    if (strcmp(argv[i], "-b") == 0 && i + 1 < argc)
+    {
+      baud = (uint32_t)atoi(argv[++i]);
+    }
+    else if (strcmp(argv[i], "-p") == 0 && i + 1 < argc)
+    {
+      poll_ms = (uint32_t)atoi(argv[++i]);
+    }
+    else if (strcmp(argv[i], "-l") == 0 && i + 1 < argc)
+    {
+      loop_us = (uint32_t)atoi(argv[++i]);
+    }
+    else if (strcmp(argv[i], "-a") == 0 && i + 1 < argc)
+    {
+      attach_us = (uint64_t)atoi(argv[++i]) * 1000;
+    }
+    else if (strcmp(argv[i], "-r") == 0)
+    {
+      raw_mode = true;
+    }
+    else if (strcmp(argv[i], "-k") == 0 && i + 1 < argc)
+    {
+      key_us = (uint32_t)atoi(argv[++i]);
+    }
+    else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc)
+    {
+      input = (uint8_t const *)argv[++i];
+      input_len = strlen(argv[i]);
+    }
+    else
+    {
+      input = read_file(argv[i], &input_len);
+      if (!input)
+      {
+        return 1;
+      }
+    }
+  }
+
+  if (!input || baud == 0 || poll_ms == 0 || loop_us == 0)
+  {
+    fprintf(stderr,
+            "usage: hid_sim [-b baud] [-p poll_ms] [-l loop_us] [-a attach_ms] [-r] [-k key_us] [-s string | file]\n");
+    return 1;
+  }
+
+  next_byte_us = 10ull * 1000000ull / baud;
+  memset(sim_flash, 0xff, sizeof(sim_flash));
+  return hid_main();
+}
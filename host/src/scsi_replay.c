@@ -0,0 +1,382 @@
+// Replay of a SCSI recording (msc/src/scsi_recorder.h)
+//
+// Reads a capture of the MSC's debug UART taken with the firmware built with SCSI_RECORD=1, for example
+//   stty -F /dev/ttyUSB0 921600 raw && cat /dev/ttyUSB0 > capture.bin
+// finds the record frames between the log lines, and feeds the READ10 and WRITE10 sectors to the firmware's own
+// file capture (msc/src/file_capture.c). Every file the instrument saved is rebuilt from the sectors the capture
+// passes on, in the order the firmware's extraction sees them, and the field of the extraction plan is printed, so
+// a problem seen with a real instrument can be reproduced and debugged on the PC. With -o, the rebuilt files are also
+// written to a folder, e.g. as a corpus for bench_csv.
+//
+// Usage: scsi_replay [-r row] [-c col] [-d delim] [-o folder] [-v] capture.bin
+//
+// -v prints every record and the debug log lines around them. -r LAST takes the field of the newest row, as ROW=LAST
+// does in CONFIG.TXT.
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "csv_extract.h"
+#include "file_capture.h"
+#include "msc_lun.h"
+#include "record_dedup.h"
+#include "scsi_recorder.h"
+
+// Same field as the firmware extracts by default (extract_plan.h)
+static int row = 5; // -1 for the newest row
+static int col = 2;
+static uint8_t delim = ',';
+static char const *out_folder = NULL;
+static bool verbose = false;
+
+static uint32_t record_time_us; // time stamp of the record being replayed
+
+typedef struct
+{
+  uint32_t records[256]; // by type
+  uint32_t dropped;      // records the firmware couldn't fit in its ring
+  uint32_t lost;         // records missing from the capture, e.g. UART overruns
+  uint32_t bad_frames;   // frames that failed their CRC
+  uint32_t files;
+} replay_stats_t;
+
+static replay_stats_t stats;
+
+static uint32_t get_u16(uint8_t const *p)
+{
+  return p[0] | (p[1] << 8);
+}
+
+static uint32_t get_u32(uint8_t const *p)
+{
+  return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+// Decode a COBS frame, returns its length or -1 if it isn't valid COBS. out must hold len bytes.
+static int32_t cobs_decode(uint8_t const *in, uint32_t len, uint8_t *out)
+{
+  uint32_t i = 0;
+  uint32_t o = 0;
+  while (i < len)
+  {
+    uint8_t code = in[i++];
+    if (i + code - 1 > len)
+    {
+      return -1;
+    }
+    for (uint8_t n = 1; n < code; n++)
+    {
+      out[o++] = in[i++];
+    }
+    if (code < 0xff && i < len)
+    {
+      out[o++] = 0;
+    }
+  }
+  return (int32_t)o;
+}
+
+// Debug log text, as opposed to a frame damaged on the way
+static bool is_text(uint8_t const *data, uint32_t len)
+{
+  for (uint32_t i = 0; i < len; i++)
+  {
+    if ((data[i] < ' ' || data[i] > '~') && data[i] != '\r' && data[i] != '\n' && data[i] != '\t')
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+//--------------------------------------------------------------------+
+// Replay
+//--------------------------------------------------------------------+
+
+// The files being written, rebuilt from their streams so they can be printed and saved whole
+typedef struct
+{
+  uint8_t *data;
+  uint32_t size;
+  uint32_t capacity;
+} rebuilt_file_t;
+
+static rebuilt_file_t rebuilt[MSC_LUN_MAX][CAPTURE_STREAMS];
+
+static void append(rebuilt_file_t *r, uint8_t const *data, uint32_t len)
+{
+  if (r->size + len > r->capacity)
+  {
+    r->capacity = (r->size + len) * 2;
+    r->data = realloc(r->data, r->capacity);
+    if (!r->data)
+    {
+      fprintf(stderr, "out of memory\n");
+      exit(1);
+    }
+  }
+  memcpy(r->data + r->size, data, len);
+  r->size += len;
+}
+
+// Invoked by file_capture.c, as in msc_disk.c
+void file_capture_start_cb(uint8_t lun, uint8_t stream)
+{
+  rebuilt[lun][stream].size = 0;
+}
+
+void file_capture_data_cb(uint8_t lun, uint8_t stream, uint8_t const *data, uint32_t len)
+{
+  append(&rebuilt[lun][stream], data, len);
+}
+
+void file_capture_done_cb(uint8_t lun, uint8_t stream, fat_file_t const *file, uint8_t const *last, uint32_t last_len)
+{
+  rebuilt_file_t *r = &rebuilt[lun][stream];
+  append(r, last, last_len);
+  uint8_t const *data = r->data;
+  uint32_t size = r->size;
+
+  stats.files++;
+  printf("%10.3f ms  LUN %u  %-12s %6lu bytes", record_time_us / 1000.0, lun, file->name, (unsigned long)size);
+
+  uint8_t const *field;
+  int32_t len;
+  if (row < 0)
+  {
+    static csv_tail_t tail;
+    csv_tail_init(&tail, delim, (uint16_t)col, 1);
+    csv_tail_feed(&tail, data, size);
+    csv_tail_end(&tail);
+    field = csv_tail_field(&tail, 0)->field;
+    len = csv_tail_count(&tail) > 0 ? csv_tail_field(&tail, 0)->len : -1;
+  }
+  else
+  {
+    len = csv_extract_field(data, size, row, col, delim, &field);
+  }
+  if (strcmp(file->name, "CONFIG.TXT") == 0)
+  {
+    printf("\n%.*s", (int)size, (char const *)data);
+  }
+  else if (len >= 0)
+  {
+    printf("  field \"%.*s\"\n", (int)len, (char const *)field);
+  }
+  else if (row < 0)
+  {
+    printf("  no row with a field in col %d\n", col);
+  }
+  else
+  {
+    printf("  no field at row %d col %d\n", row, col);
+  }
+
+  if (out_folder)
+  {
+    char path[4096];
+    snprintf(path, sizeof(path), "%s/%03lu_%s", out_folder, (unsigned long)stats.files, file->name);
+    FILE *f = fopen(path, "wb");
+    if (!f || fwrite(data, 1, size, f) != size)
+    {
+      fprintf(stderr, "can't write %s\n", path);
+    }
+    if (f)
+    {
+      fclose(f);
+    }
+  }
+}
+
+static void print_log(uint8_t const *text, uint32_t len)
+{
+  for (uint32_t i = 0; i < len; i++)
+  {
+    if (text[i] != '\r')
+    {
+      putchar(text[i] >= ' ' || text[i] == '\n' ? text[i] : '.');
+    }
+  }
+}
+
+static void replay_record(uint8_t const *rec, uint32_t len)
+{
+  static bool first = true;
+  static uint16_t next_seq;
+
+  uint8_t type = rec[0];
+  uint8_t lun = rec[1];
+  uint16_t seq = (uint16_t)get_u16(&rec[2]);
+  uint32_t lba = get_u32(&rec[8]);
+  uint32_t length = get_u32(&rec[12]);
+  uint8_t const *payload = &rec[SCSI_RECORD_HEADER_SIZE];
+  record_time_us = get_u32(&rec[4]);
+
+  if (SCSI_RECORD_HEADER_SIZE + length != len || lun >= MSC_LUN_MAX)
+  {
+    stats.bad_frames++;
+    return;
+  }
+  if (type == SCSI_RECORD_DROPPED)
+  {
+    next_seq = (uint16_t)(next_seq + lba); // the dropped records had the numbers before this one
+  }
+  if (!first && seq != next_seq)
+  {
+    stats.lost += (uint16_t)(seq - next_seq);
+  }
+  first = false;
+  next_seq = (uint16_t)(seq + 1);
+  stats.records[type]++;
+
+  if (verbose)
+  {
+    printf("%10.3f ms  #%-5u %c LUN %u", record_time_us / 1000.0, seq, type, lun);
+    if (type == SCSI_RECORD_COMMAND)
+    {
+      printf("  CDB");
+      for (uint32_t i = 0; i < length; i++)
+      {
+        printf(" %02X", payload[i]);
+      }
+      printf("\n");
+    }
+    else
+    {
+      printf("  LBA %lu  %lu bytes\n", (unsigned long)lba, (unsigned long)length);
+    }
+  }
+
+  switch (type)
+  {
+  case SCSI_RECORD_READ10:
+    file_capture_read(lun, lba, payload, length);
+    break;
+  case SCSI_RECORD_WRITE10:
+    file_capture_write(lun, lba, payload, length);
+    break;
+  case SCSI_RECORD_DROPPED:
+    stats.dropped += lba;
+    printf("%10.3f ms  %lu records dropped by the firmware, files may be missing\n", record_time_us / 1000.0,
+           (unsigned long)lba);
+    break;
+  default:
+    break;
+  }
+}
+
+// Split the capture at the 0x00 delimiters. Anything that isn't a valid frame is debug log text.
+static void replay(uint8_t const *capture, uint32_t size)
+{
+  static uint8_t rec[SCSI_RECORD_HEADER_SIZE + SCSI_RECORD_MAX_PAYLOAD + 4];
+  uint32_t start = 0;
+  for (uint32_t i = 0; i <= size; i++)
+  {
+    if (i < size && capture[i] != 0)
+    {
+      continue;
+    }
+    uint8_t const *chunk = &capture[start];
+    uint32_t len = i - start;
+    start = i + 1;
+    if (len == 0)
+    {
+      continue;
+    }
+
+    int32_t rec_len = len <= sizeof(rec) ? cobs_decode(chunk, len, rec) : -1;
+    if (rec_len >= SCSI_RECORD_HEADER_SIZE + 4 &&
+        dedup_crc32(0, rec, (uint32_t)rec_len - 4) == get_u32(&rec[rec_len - 4]))
+    {
+      replay_record(rec, (uint32_t)rec_len - 4);
+    }
+    else if (is_text(chunk, len))
+    {
+      if (verbose)
+      {
+        print_log(chunk, len);
+      }
+    }
+    else
+    {
+      stats.bad_frames++;
+    }
+  }
+}
+
+int main(int argc, char **argv)
+{
+  char const *path = NULL;
+  for (int i = 1; i < argc; i++)
+  {
+    if (strcmp(argv[i], "-r") == 0 && i + 1 < argc)
+    {
+      i++;
+      row = strcmp(argv[i], "LAST") == 0 ? -1 : atoi(argv[i]);
+    }
+    else if (strcmp(argv[i], "-c") == 0 && i + 1 < argc)
+    {
+      col = atoi(argv[++i]);
+    }
+    else if (strcmp(argv[i], "-d") == 0 && i + 1 < argc)
+    {
+      i++;
+      delim = strcmp(argv[i], "TAB") == 0 ? '\t' : (uint8_t)argv[i][0];
+    }
+    else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+    {
+      out_folder = argv[++i];
+    }
+    else if (strcmp(argv[i], "-v") == 0)
+    {
+      verbose = true;
+    }
+    else if (!path && argv[i][0] != '-')
+    {
+      path = argv[i];
+    }
+    else
+    {
+      path = NULL;
+      break;
+    }
+  }
+  if (!path)
+  {
+    fprintf(stderr, "usage: %s [-r row] [-c col] [-d delim] [-o folder] [-v] capture.bin\n", argv[0]);
+    return 2;
+  }
+
+  FILE *f = fopen(path, "rb");
+  if (!f)
+  {
+    perror(path);
+    return 1;
+  }
+  fseek(f, 0, SEEK_END);
+  long size = ftell(f);
+  fseek(f, 0, SEEK_SET);
+  uint8_t *capture = malloc(size > 0 ? (size_t)size : 1);
+  if (!capture || fread(capture, 1, (size_t)size, f) != (size_t)size)
+  {
+    fprintf(stderr, "can't read %s\n", path);
+    return 1;
+  }
+  fclose(f);
+
+  replay(capture, (uint32_t)size);
+  free(capture);
+
+  printf("\n%lu READ10, %lu WRITE10, %lu other commands, %lu files\n",
+         (unsigned long)stats.records[SCSI_RECORD_READ10], (unsigned long)stats.records[SCSI_RECORD_WRITE10],
+         (unsigned long)stats.records[SCSI_RECORD_COMMAND], (unsigned long)stats.files);
+  if (stats.dropped || stats.lost || stats.bad_frames)
+  {
+    printf("%lu records dropped by the firmware, %lu lost, %lu bad frames\n", (unsigned long)stats.dropped,
+           (unsigned long)stats.lost, (unsigned long)stats.bad_frames);
+  }
+  return 0;
+}
@@ -0,0 +1,158 @@
+// Tests of the column statistics (msc/src/column_stats.c)
+//
+// The 64 bit helpers are checked on their own, with the products and square roots at the edges of their range,
+// and whole columns of known values are summarised and compared with the expected line: rounding of the mean and the
+// standard deviation, negative values, columns whose decimals change, and values that can't be added.
+//
+// Usage: test_column_stats
+//
+// Prints every failed check and exits with 1 if there was one, as run by ctest.
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "column_stats.c" // the helpers are static
+
+static int failures = 0;
+
+static void check_mul_shr24(uint64_t a, uint64_t b, uint64_t expected)
+{
+  uint64_t got = mul_shr24(a, b);
+  if (got != expected)
+  {
+    printf("FAIL: mul_shr24(0x%llx, 0x%llx): got 0x%llx, expected 0x%llx\n", (unsigned long long)a,
+           (unsigned long long)b, (unsigned long long)got, (unsigned long long)expected);
+    failures++;
+  }
+}
+
+static void check_isqrt64(uint64_t n, uint32_t expected)
+{
+  uint32_t got = isqrt64(n);
+  if (got != expected)
+  {
+    printf("FAIL: isqrt64(%llu): got %lu, expected %lu\n", (unsigned long long)n, (unsigned long)got,
+           (unsigned long)expected);
+    failures++;
+  }
+}
+
+// Summarise a column given as text, fields separated by spaces. expected is "" if nothing can be written.
+// rejected is the number of fields column_stats_add must refuse.
+static void check_column(char const *column, uint8_t decimals, char const *expected, uint32_t rejected)
+{
+  column_stats_t stats;
+  column_stats_init(&stats);
+  uint32_t refused = 0;
+  for (char const *p = column; *p;)
+  {
+    char const *end = strchr(p, ' ');
+    uint32_t len = end ? (uint32_t)(end - p) : (uint32_t)strlen(p);
+    fixed_t value;
+    if (!fixed_parse((uint8_t const *)p, len, &value))
+    {
+      printf("FAIL: \"%.*s\" isn't a number\n", (int)len, p);
+      failures++;
+    }
+    else if (!column_stats_add(&stats, &value))
+    {
+      refused++;
+    }
+    p += len + (end ? 1 : 0);
+  }
+
+  char text[80];
+  uint32_t len = column_stats_format(&stats, decimals, '.', text, sizeof(text));
+  text[len] = '\0';
+  if (strcmp(text, expected) != 0 || refused != rejected)
+  {
+    printf("FAIL: \"%s\" decimals %u: got \"%s\" with %lu refused, expected \"%s\" with %lu\n", column, decimals,
+           text, (unsigned long)refused, expected, (unsigned long)rejected);
+    failures++;
+  }
+}
+
+int main(void)
+{
+  // (a * b) >> 24, saturating once the result needs more than 64 bits
+  check_mul_shr24(0, UINT64_MAX, 0);
+  check_mul_shr24(1ull << 24, 5, 5);
+  check_mul_shr24(3, 1ull << 24, 3);
+  check_mul_shr24((1ull << 24) - 1, 1, 0);
+  check_mul_shr24(0xffffffffffull, 1ull << 24, 0xffffffffffull);
+  check_mul_shr24(0x123456789abcdefull, 0x1000, 0x123456789abcdefull >> 12);
+  check_mul_shr24(1ull << 40, 1ull << 40, 1ull << 56);
+  check_mul_shr24(1ull << 43, 1ull << 44, 1ull << 63);
+  check_mul_shr24(UINT64_MAX, 1ull << 24, UINT64_MAX);
+  check_mul_shr24(1ull << 44, 1ull << 44, UINT64_MAX);
+  check_mul_shr24(UINT64_MAX, UINT64_MAX, UINT64_MAX);
+  check_mul_shr24(0xffffffffull, 0xffffffffull, 0xfffffffe00000001ull >> 24);
+#ifdef __SIZEOF_INT128__
+  // Against a 128 bit product, with carries between the 32 bit halves
+  uint64_t x = 0x9e3779b97f4a7c15ull;
+  for (int i = 0; i < 1000; i++)
+  {
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    uint64_t a = x >> (i % 40);
+    uint64_t b = (x * 0xbf58476d1ce4e5b9ull) >> (24 + i % 40);
+    unsigned __int128 product = ((unsigned __int128)a * b) >> 24;
+    check_mul_shr24(a, b, product >> 64 ? UINT64_MAX : (uint64_t)product);
+  }
+#endif
+
+  // Floor of the square root, over the whole 64 bit range
+  check_isqrt64(0, 0);
+  check_isqrt64(1, 1);
+  check_isqrt64(2, 1);
+  check_isqrt64(3, 1);
+  check_isqrt64(4, 2);
+  check_isqrt64(15, 3);
+  check_isqrt64(16, 4);
+  check_isqrt64(1ull << 62, 1u << 31);
+  check_isqrt64(0xfffffffe00000001ull, 0xffffffffu); // (2^32 - 1)^2
+  check_isqrt64(0xfffffffe00000000ull, 0xfffffffeu);
+  check_isqrt64(UINT64_MAX, 0xffffffffu);
+
+  // Count, mean, minimum, maximum and sample standard deviation
+  check_column("2 4 4 4 5 5 7 9", 3, "8\t5.000\t2.000\t9.000\t2.000", 0); // in units of the column's decimals
+  check_column("2 4 4 4 5 5 7 9", 0, "8\t5\t2\t9\t2", 0);
+  check_column("42", 1, "1\t42.0\t42.0\t42.0\t0.0", 0);
+  check_column("1.5 -2.5", 2, "2\t-0.50\t-2.50\t1.50\t2.80", 0);
+  check_column("-1.5 -2.5", 1, "2\t-2.0\t-2.5\t-1.5\t0.7", 0);
+
+  // The mean and the standard deviation are rounded half away from zero
+  check_column("1 2", 0, "2\t2\t1\t2\t1", 0);
+  check_column("-1 -2", 0, "2\t-2\t-2\t-1\t1", 0);
+  check_column("0.25 0.5", 1, "2\t0.4\t0.3\t0.5\t0.2", 0);
+  check_column("-0.25 -0.5", 1, "2\t-0.4\t-0.5\t-0.3\t0.2", 0);
+
+  // Decimals above FIXED_MAX_DECIMALS keep those of the column, raised by a value with more of them
+  check_column("1 2.5 3.25", FIXED_MAX_DECIMALS + 1, "3\t2.25\t1.00\t3.25\t1.15", 0);
+  check_column("3.25 2.5 1", FIXED_MAX_DECIMALS + 1, "3\t2.25\t1.00\t3.25\t1.15", 0);
+
+  // A value that can't be brought to the decimals of the others is refused, the statistics stay as they were
+  check_column("999999999 0.5", FIXED_MAX_DECIMALS + 1, "1\t999999999\t999999999\t999999999\t0", 1);
+  check_column("0.000000001 999999999", FIXED_MAX_DECIMALS + 1, "1\t0.000000001\t0.000000001\t0.000000001\t0.000000000",
+               1);
+
+  // The full range of 9 digit values, whose standard deviation doesn't fit in 9 digits
+  check_column("999999999 -999999999", 0, "", 0);
+  check_column("999999999 -999999999", 1, "", 0);
+  check_column("-999999999 -999999999 -999999999", 0, "3\t-999999999\t-999999999\t-999999999\t0", 0);
+
+  // Nothing to write
+  check_column("", 2, "", 0);
+  check_column("1 2", 10, "2\t2\t1\t2\t1", 0);
+
+  if (failures > 0)
+  {
+    printf("%d checks failed\n", failures);
+    return 1;
+  }
+  printf("all checks passed\n");
+  return 0;
+}
@@ -0,0 +1,155 @@
+// Tests of the streaming CSV scan and tail (csv_scan and csv_tail in msc/src/csv_extract.c)
+//
+// Known files are fed in pieces of every size from 1 byte to the whole file, so that each field, quote and line break
+// is split across two calls somewhere, and the fields seen are compared with the expected ones: quoted fields with
+// delimiters and line breaks, "" escapes, CRLF line breaks, fields cut at CSV_SCAN_FIELD_MAX, NUL sector padding and
+// a last line without a line break. The tail is checked for the newest rows of the column, blank lines skipped.
+//
+// Usage: test_csv_scan
+//
+// Prints every failed check and exits with 1 if there was one, as run by ctest.
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "csv_extract.h"
+
+static int failures = 0;
+
+typedef struct
+{
+  char text[512];
+  uint32_t len;
+} fields_t;
+
+// Each field as "row:text|", with a '~' before the '|' if it was cut short
+static void append(fields_t *fields, uint32_t row, uint8_t const *field, uint32_t len, bool truncated)
+{
+  fields->len += (uint32_t)snprintf(fields->text + fields->len, sizeof(fields->text) - fields->len, "%lu:%.*s%s|",
+                                    (unsigned long)row, (int)len, (char const *)field, truncated ? "~" : "");
+}
+
+static void scan_cb(void *ctx, uint32_t row, uint8_t const *field, uint32_t len, bool truncated)
+{
+  append(ctx, row, field, len, truncated);
+}
+
+// Scan column col of data, size bytes, fed piece bytes at a time
+static void check_scan(char const *name, char const *data, uint32_t size, uint8_t delim, uint16_t col,
+                       char const *expected)
+{
+  for (uint32_t piece = 1; piece <= size; piece++)
+  {
+    csv_scan_t scan;
+    fields_t fields = {.len = 0};
+    csv_scan_init(&scan, delim, col);
+    for (uint32_t off = 0; off < size; off += piece)
+    {
+      csv_scan_feed(&scan, (uint8_t const *)data + off, size - off < piece ? size - off : piece, scan_cb, &fields);
+    }
+    csv_scan_end(&scan, scan_cb, &fields);
+    if (strcmp(fields.text, expected) != 0)
+    {
+      printf("FAIL: %s column %u in pieces of %lu: got \"%s\", expected \"%s\"\n", name, col, (unsigned long)piece,
+             fields.text, expected);
+      failures++;
+      return; // one report per file is enough
+    }
+  }
+}
+
+// Keep the newest rows of column col, fed piece bytes at a time, and list them the oldest first
+static void check_tail(char const *name, char const *data, uint8_t delim, uint16_t col, uint8_t rows,
+                       char const *expected)
+{
+  uint32_t size = (uint32_t)strlen(data);
+  for (uint32_t piece = 1; piece <= size; piece++)
+  {
+    csv_tail_t tail;
+    fields_t fields = {.len = 0};
+    csv_tail_init(&tail, delim, col, rows);
+    for (uint32_t off = 0; off < size; off += piece)
+    {
+      csv_tail_feed(&tail, (uint8_t const *)data + off, size - off < piece ? size - off : piece);
+    }
+    csv_tail_end(&tail);
+    for (uint32_t n = 0; n < csv_tail_count(&tail); n++)
+    {
+      csv_tail_field_t const *f = csv_tail_field(&tail, n);
+      append(&fields, f->row, f->field, f->len, f->truncated);
+    }
+    if (strcmp(fields.text, expected) != 0)
+    {
+      printf("FAIL: %s tail of %u in pieces of %lu: got \"%s\", expected \"%s\"\n", name, rows, (unsigned long)piece,
+             fields.text, expected);
+      failures++;
+      return;
+    }
+  }
+}
+
+int main(void)
+{
+  // Plain fields, LF and CRLF, and a last line without a line break
+  char const plain[] = "time,volts,amps\n1,12.5,0.25\n2,12.4,0.30\n3,12.3,0.35";
+  check_scan("plain", plain, sizeof(plain) - 1, ',', 0, "0:time|1:1|2:2|3:3|");
+  check_scan("plain", plain, sizeof(plain) - 1, ',', 1, "0:volts|1:12.5|2:12.4|3:12.3|");
+  check_scan("plain", plain, sizeof(plain) - 1, ',', 2, "0:amps|1:0.25|2:0.30|3:0.35|");
+  check_scan("plain", plain, sizeof(plain) - 1, ',', 3, "");
+  char const crlf[] = "a;b\r\n1;2,5\r\n3;4,5\r\n";
+  check_scan("crlf", crlf, sizeof(crlf) - 1, ';', 1, "0:b|1:2,5|2:4,5|");
+  check_scan("crlf", crlf, sizeof(crlf) - 1, ';', 0, "0:a|1:1|2:3|");
+  char const tabs[] = "x\ty\n\t7\n8\t\n";
+  check_scan("tabs", tabs, sizeof(tabs) - 1, '\t', 1, "0:y|1:7|2:|");
+
+  // Quoted fields hold delimiters, line breaks and "" escapes, and a CR after the closing quote is dropped
+  char const quoted[] = "name,note,value\r\n"
+                        "\"a,b\",\"line 1\nline 2\",1\r\n"
+                        "c,\"say \"\"hi\"\"\",\"2\"\r\n"
+                        "\"\",\"\",3\r\n";
+  check_scan("quoted", quoted, sizeof(quoted) - 1, ',', 0, "0:name|1:a,b|2:c|3:|");
+  check_scan("quoted", quoted, sizeof(quoted) - 1, ',', 1, "0:note|1:line 1\nline 2|2:say \"hi\"|3:|");
+  check_scan("quoted", quoted, sizeof(quoted) - 1, ',', 2, "0:value|1:1|2:2|3:3|");
+
+  // Fields longer than CSV_SCAN_FIELD_MAX are cut, one that fits exactly isn't, with either line break
+  char const cut[] = "0123456789abcdef0123456789abcdef,1\n"
+                     "0123456789abcdef0123456789abcdefg,2\n"
+                     "0123456789abcdef0123456789abcdef\r\n"
+                     "\"0123456789abcdef0123456789abcdef\"\r\n"
+                     "0123456789abcdef0123456789abcdef\r,5\n"
+                     "0123456789abcdef0123456789abcdef\rx\r\n";
+  check_scan("cut", cut, sizeof(cut) - 1, ',', 0,
+             "0:0123456789abcdef0123456789abcdef|1:0123456789abcdef0123456789abcdef~|"
+             "2:0123456789abcdef0123456789abcdef|3:0123456789abcdef0123456789abcdef|"
+             "4:0123456789abcdef0123456789abcdef~|5:0123456789abcdef0123456789abcdef~|");
+
+  // The sector padding after the end of the file stops the scan, even without csv_scan_end
+  char const padded[] = "1,a\n2,b\n3,c\0\0\0\0\0\0\0\0\0\0\n4,d\n";
+  check_scan("padded", padded, sizeof(padded) - 1, ',', 1, "0:a|1:b|2:c|");
+  char const padded_lf[] = "1,a\n2,b\n\0\0\0\0\0\0\0\0";
+  check_scan("padded", padded_lf, sizeof(padded_lf) - 1, ',', 0, "0:1|1:2|");
+
+  // An unterminated quote runs to the end of the file
+  char const open_quote[] = "1,\"a\n2,b\n";
+  check_scan("open quote", open_quote, sizeof(open_quote) - 1, ',', 1, "0:a\n2,b\n|");
+
+  // The newest rows, the oldest first, without the blank lines
+  char const log[] = "t,v\n1,10\n2,20\n3,30\n4,40\n5,50\n\n";
+  check_tail("log", log, ',', 1, 1, "5:50|");
+  check_tail("log", log, ',', 1, 3, "3:30|4:40|5:50|");
+  check_tail("log", log, ',', 1, 8, "0:v|1:10|2:20|3:30|4:40|5:50|");
+  check_tail("log", log, ',', 1, 0, "5:50|");
+  check_tail("log", log, ',', 2, 2, "");
+  check_tail("log", "t,v\n1,10\n2,\n3,30\r\n4,", ',', 1, 2, "1:10|3:30|");
+  check_tail("log", "1;\"a;1\"\n2;\"b\nc\"", ';', 1, 4, "0:a;1|1:b\nc|");
+
+  if (failures > 0)
+  {
+    printf("%d checks failed\n", failures);
+    return 1;
+  }
+  printf("all checks passed\n");
+  return 0;
+}
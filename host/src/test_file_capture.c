@@ -0,0 +1,249 @@
+// Tests of the file capture (msc/src/file_capture.c)
+//
+// Replays the sector writes of a host saving files on the firmware's volume: the data sectors, then the FAT, then
+// the directory entries. The files handed to file_capture_done_cb are rebuilt and compared with the ones written,
+// and the streams must all be closed once the host is done: files that fit in the arena, files written back to back
+// before the FAT, and files larger than the arena, which are passed on without the FAT and can run into the next
+// file.
+//
+// Usage: test_file_capture
+//
+// Prints every failed check and exits with 1 if there was one, as run by ctest.
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "file_capture.c" // for the state of the streams
+
+static int failures = 0;
+
+#define MAX_FILE_SECTORS 256
+
+// The files being written, rebuilt from their streams
+static uint8_t rebuilt[CAPTURE_STREAMS][MAX_FILE_SECTORS * DISK_BLOCK_SIZE];
+static uint32_t rebuilt_size[CAPTURE_STREAMS];
+
+// The files handed on, as "NAME size|", with "!" before the '|' if the data isn't the one written
+static char done[256];
+
+// The volume as the host sees it
+static uint8_t fat_sector[DISK_BLOCK_SIZE];
+static uint8_t root_sector[DISK_BLOCK_SIZE];
+
+// Byte n of a file, different in every file and every sector
+static uint8_t file_byte(uint16_t first_cluster, uint32_t n)
+{
+  return (uint8_t)(first_cluster * 7 + n / DISK_BLOCK_SIZE * 3 + n);
+}
+
+void file_capture_start_cb(uint8_t lun, uint8_t stream)
+{
+  (void)lun;
+  rebuilt_size[stream] = 0;
+}
+
+void file_capture_data_cb(uint8_t lun, uint8_t stream, uint8_t const *data, uint32_t len)
+{
+  (void)lun;
+  if (rebuilt_size[stream] + len <= sizeof(rebuilt[stream]))
+  {
+    memcpy(&rebuilt[stream][rebuilt_size[stream]], data, len);
+  }
+  rebuilt_size[stream] += len;
+}
+
+void file_capture_done_cb(uint8_t lun, uint8_t stream, fat_file_t const *file, uint8_t const *data, uint32_t len)
+{
+  file_capture_data_cb(lun, stream, data, len);
+  bool same = rebuilt_size[stream] == file->size;
+  for (uint32_t n = 0; same && n < file->size; n++)
+  {
+    same = rebuilt[stream][n] == file_byte(file->first_cluster, n);
+  }
+  size_t used = strlen(done);
+  snprintf(done + used, sizeof(done) - used, "%s %lu%s|", file->name, (unsigned long)file->size, same ? "" : "!");
+}
+
+static uint32_t sectors_of(uint32_t size)
+{
+  return (size + DISK_BLOCK_SIZE - 1) / DISK_BLOCK_SIZE;
+}
+
+static uint32_t clusters_of(uint32_t size)
+{
+  return (sectors_of(size) + DISK_SECTORS_PER_CLUSTER - 1) / DISK_SECTORS_PER_CLUSTER;
+}
+
+// The data sectors of a file, in contiguous clusters
+static void write_data(uint16_t first_cluster, uint32_t size)
+{
+  uint8_t sector[DISK_BLOCK_SIZE];
+  for (uint32_t s = 0; s < sectors_of(size); s++)
+  {
+    for (uint32_t i = 0; i < DISK_BLOCK_SIZE; i++)
+    {
+      uint32_t n = s * DISK_BLOCK_SIZE + i;
+      sector[i] = n < size ? file_byte(first_cluster, n) : 0;
+    }
+    file_capture_write(0, DISK_CLUSTER_LBA(first_cluster) + s, sector, DISK_BLOCK_SIZE);
+  }
+}
+
+// The chain of a file in the first FAT sector, written to both FATs
+static void write_fat(uint16_t first_cluster, uint32_t size)
+{
+  uint32_t clusters = clusters_of(size);
+  for (uint32_t c = 0; c < clusters; c++)
+  {
+    uint16_t next = c + 1 < clusters ? (uint16_t)(first_cluster + c + 1) : 0xffff;
+    fat_sector[(first_cluster + c) * 2] = (uint8_t)next;
+    fat_sector[(first_cluster + c) * 2 + 1] = (uint8_t)(next >> 8);
+  }
+  file_capture_write(0, DISK_FAT_LBA, fat_sector, DISK_BLOCK_SIZE);
+  file_capture_write(0, DISK_FAT_LBA + DISK_FAT_SECTORS, fat_sector, DISK_BLOCK_SIZE);
+}
+
+// The entry of a file in the first root directory sector, which isn't written yet
+static void add_entry(uint32_t slot, char const *name83, uint16_t first_cluster, uint32_t size)
+{
+  uint8_t *e = &root_sector[slot * DIR_ENTRY_SIZE];
+  memcpy(e, name83, 11);
+  e[11] = 0x20;
+  e[26] = (uint8_t)first_cluster;
+  e[27] = (uint8_t)(first_cluster >> 8);
+  for (uint32_t i = 0; i < 4; i++)
+  {
+    e[28 + i] = (uint8_t)(size >> (8 * i));
+  }
+}
+
+static void write_root(void)
+{
+  file_capture_write(0, DISK_ROOT_DIR_LBA, root_sector, DISK_BLOCK_SIZE);
+}
+
+static void start_case(void)
+{
+  memset(&volumes[0], 0, sizeof(volumes[0]));
+  memset(fat_sector, 0, sizeof(fat_sector));
+  memset(root_sector, 0, sizeof(root_sector));
+  done[0] = '\0';
+}
+
+static void check_case(char const *name, char const *expected)
+{
+  uint32_t open = 0;
+  for (uint32_t i = 0; i < CAPTURE_STREAMS; i++)
+  {
+    open += volumes[0].streams[i].open;
+  }
+  if (strcmp(done, expected) != 0 || open > 0)
+  {
+    printf("FAIL: %s: got \"%s\" with %lu streams open, expected \"%s\" with none\n", name, done,
+           (unsigned long)open, expected);
+    failures++;
+  }
+}
+
+int main(void)
+{
+  uint32_t const arena_sectors = CAPTURE_MAX_SECTORS;
+  uint32_t const cluster_bytes = DISK_SECTORS_PER_CLUSTER * DISK_BLOCK_SIZE;
+
+  // A file that fits in the arena
+  start_case();
+  write_data(10, 5000);
+  write_fat(10, 5000);
+  add_entry(0, "DATA0001CSV", 10, 5000);
+  write_root();
+  check_case("one file", "DATA0001.CSV 5000|");
+
+  // The directory entry before the FAT, and a file that isn't extracted
+  start_case();
+  write_data(10, 700);
+  add_entry(0, "DATA0001CSV", 10, 700);
+  write_root();
+  write_fat(10, 700);
+  write_data(11, 100);
+  write_fat(11, 100);
+  add_entry(1, "NOTES   TXT", 11, 100);
+  write_root();
+  check_case("entry first", "DATA0001.CSV 700|");
+
+  // Two files written back to back before the FAT, the first one ending with its last cluster
+  start_case();
+  write_data(10, 2 * cluster_bytes);
+  write_data(12, 3000);
+  write_fat(10, 2 * cluster_bytes);
+  write_fat(12, 3000);
+  add_entry(0, "DATA0001CSV", 10, 2 * cluster_bytes);
+  add_entry(1, "DATA0002CSV", 12, 3000);
+  write_root();
+  check_case("back to back", "DATA0001.CSV 4096|DATA0002.CSV 3000|");
+
+  // A file larger than the arena is passed on without the FAT, and still extracted
+  uint32_t const large = (arena_sectors + 30) * DISK_BLOCK_SIZE - 10;
+  char expected[64];
+  start_case();
+  write_data(10, large);
+  write_fat(10, large);
+  add_entry(0, "DATA0001CSV", 10, large);
+  write_root();
+  snprintf(expected, sizeof(expected), "DATA0001.CSV %lu|", (unsigned long)large);
+  check_case("larger than the arena", expected);
+
+  // A file larger than the arena, with the next one right behind it, so that the stream is passed on past its end.
+  // The first file is lost, and so is the second one, whose clusters were passed on with the first one once the FAT
+  // linked them.
+  uint32_t const first_size = (arena_sectors + 4) * DISK_BLOCK_SIZE - 10; // ends with its last cluster
+  uint32_t const second_size = arena_sectors * DISK_BLOCK_SIZE;
+  uint16_t const second = (uint16_t)(10 + clusters_of(first_size));
+  start_case();
+  write_data(10, first_size);
+  write_data(second, second_size);
+  write_fat(10, first_size);
+  write_fat(second, second_size);
+  add_entry(0, "DATA0001CSV", 10, first_size);
+  add_entry(1, "DATA0002CSV", second, second_size);
+  write_root();
+  check_case("past the end", "");
+
+  // The same, with the entries written before the FAT links the second file. The stream was passed on up to the end
+  // of the first file's last cluster only, so the second file is still in the arena and goes on as a stream of its
+  // own, extracted once the host writes its entry again.
+  start_case();
+  write_data(10, first_size);
+  write_data(second, second_size);
+  add_entry(0, "DATA0001CSV", 10, first_size);
+  add_entry(1, "DATA0002CSV", second, second_size);
+  write_root();
+  write_fat(10, first_size);
+  write_fat(second, second_size);
+  write_root();
+  snprintf(expected, sizeof(expected), "DATA0002.CSV %lu|", (unsigned long)second_size);
+  check_case("up to the end", expected);
+
+  // The stream of a lost file is free for the next one
+  start_case();
+  write_data(10, first_size);
+  write_data(second, second_size);
+  write_fat(10, first_size);
+  write_fat(second, second_size);
+  add_entry(0, "DATA0001CSV", 10, first_size);
+  write_root();
+  write_data(200, 1000);
+  write_fat(200, 1000);
+  add_entry(1, "DATA0003CSV", 200, 1000);
+  write_root();
+  check_case("after a lost file", "DATA0003.CSV 1000|");
+
+  if (failures > 0)
+  {
+    printf("%d checks failed\n", failures);
+    return 1;
+  }
+  printf("all checks passed\n");
+  return 0;
+}
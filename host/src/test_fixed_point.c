@@ -0,0 +1,127 @@
+// Tests of the fixed-point readings (msc/src/fixed_point.c)
+//
+// Known fields are parsed, rescaled and formatted, and the text is compared with the expected one: rounding half
+// away from zero, negative values and zero, exponents, decimal commas, and numbers that don't fit in 9 digits.
+//
+// Usage: test_fixed_point
+//
+// Prints every failed check and exits with 1 if there was one, as run by ctest.
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "fixed_point.h"
+
+static int failures = 0;
+
+// Parse a field, rescale it unless decimals is negative, and format it. expected is NULL if the field must be
+// rejected.
+static void check(char const *field, int decimals, char point, char const *expected)
+{
+  char text[32] = "";
+  fixed_t value;
+  bool ok = fixed_parse((uint8_t const *)field, (uint32_t)strlen(field), &value) &&
+            (decimals < 0 || fixed_rescale(&value, (uint8_t)decimals)) &&
+            fixed_format(&value, point, text, sizeof(text)) > 0;
+  if (expected ? !ok || strcmp(text, expected) != 0 : ok)
+  {
+    printf("FAIL: \"%s\" decimals %d: got %s, expected %s\n", field, decimals, ok ? text : "(rejected)",
+           expected ? expected : "(rejected)");
+    failures++;
+  }
+}
+
+static void check_format_size(int32_t mantissa, uint8_t decimals, uint32_t size, uint32_t expected)
+{
+  fixed_t value = {.mantissa = mantissa, .decimals = decimals};
+  char text[32];
+  uint32_t len = fixed_format(&value, '.', text, size);
+  if (len != expected)
+  {
+    printf("FAIL: format %ld/10^%u in %lu bytes: got %lu, expected %lu\n", (long)mantissa, decimals,
+           (unsigned long)size, (unsigned long)len, (unsigned long)expected);
+    failures++;
+  }
+}
+
+int main(void)
+{
+  // As written, in the canonical form
+  check("1.25", -1, '.', "1.25");
+  check("007.50", -1, '.', "7.50");
+  check(" +42 ", -1, '.', "42");
+  check("1.", -1, '.', "1");
+  check(",5", -1, '.', "0.5");
+  check("3,14", -1, ',', "3,14");
+  check("-0", -1, '.', "0");
+  check("-0.0", -1, '.', "0.0");
+  check("-12.5", -1, '.', "-12.5");
+  check("999999999", -1, '.', "999999999");
+  check("-999999999", -1, '.', "-999999999");
+
+  // Exponents
+  check("-1,25E-3", -1, '.', "-0.00125");
+  check("1e3", -1, '.', "1000");
+  check("2.5E+2", -1, '.', "250");
+  check("1E-9", -1, '.', "0.000000001");
+
+  // Digits past the 9th significant one, and values below 10^-9, are rounded half away from zero
+  check("1.234567895", -1, '.', "1.23456790");
+  check("1.234567894", -1, '.', "1.23456789");
+  check("-1.234567895", -1, '.', "-1.23456790");
+  check("9.999999995", -1, '.', "10.0000000");
+  check("0.0000000004", -1, '.', "0.000000000");
+  check("0.0000000005", -1, '.', "0.000000001");
+  check("-0.0000000005", -1, '.', "-0.000000001");
+
+  // Too large for 9 digits
+  check("1234567890", -1, '.', NULL);
+  check("1234567894", -1, '.', NULL);
+  check("999999999.5", -1, '.', NULL);
+  check("1E9", -1, '.', NULL);
+  check("1E100", -1, '.', NULL);
+
+  // Not numbers
+  check("", -1, '.', NULL);
+  check("   ", -1, '.', NULL);
+  check("-", -1, '.', NULL);
+  check(".", -1, '.', NULL);
+  check("1.2.3", -1, '.', NULL);
+  check("12V", -1, '.', NULL);
+  check("1e", -1, '.', NULL);
+  check("e5", -1, '.', NULL);
+  check("1 2", -1, '.', NULL);
+
+  // Rescaling rounds half away from zero, and a rounded negative value that becomes zero has no sign
+  check("1.25", 1, '.', "1.3");
+  check("-1.25", 1, '.', "-1.3");
+  check("1.24", 1, '.', "1.2");
+  check("-1.24", 1, '.', "-1.2");
+  check("0.5", 0, '.', "1");
+  check("-0.5", 0, '.', "-1");
+  check("-0.04", 1, '.', "0.0");
+  check("2.999999999", 2, '.', "3.00");
+  check("7", 3, '.', "7.000");
+  check("-7", 3, ',', "-7,000");
+
+  // Extending past 9 digits or 9 decimals
+  check("999999999", 1, '.', NULL);
+  check("99999999.9", 2, '.', NULL);
+  check("1", 10, '.', NULL);
+
+  // The text and its terminating NUL must fit
+  check_format_size(-125, 5, 8, 0);
+  check_format_size(-125, 5, 9, 8);
+  check_format_size(0, 0, 1, 0);
+  check_format_size(0, 0, 2, 1);
+
+  if (failures > 0)
+  {
+    printf("%d checks failed\n", failures);
+    return 1;
+  }
+  printf("all checks passed\n");
+  return 0;
+}
@@ -0,0 +1,63 @@
+#include <stdio.h>
+
+#include "pico/stdlib.h"
+#include "boot_time.h"
+#include "extract_plan.h"
+#include "flash_store.h"
+#include "sched.h"
+
+static char const *const mark_names[BOOT_MARKS] = {
+    [BOOT_MAIN] = "main",
+    [BOOT_USB_CONNECT] = "usb connect",
+    [BOOT_MOUNTED] = "mounted",
+    [BOOT_FIRST_SCSI] = "first scsi",
+};
+
+static uint32_t mark_us[BOOT_MARKS]; // 0 until the step has happened
+
+void boot_mark(boot_mark_t mark)
+{
+  if (mark_us[mark] == 0)
+  {
+    uint32_t now = time_us_32();
+    mark_us[mark] = now ? now : 1;
+  }
+}
+
+static uint32_t boot_task(void)
+{
+  static bool waited = false;
+  if (!waited)
+  {
+    waited = true;
+    return BOOT_REPORT_MS;
+  }
+
+  printf("### BOOT:");
+  for (int i = 0; i < BOOT_MARKS; i++)
+  {
+    if (mark_us[i])
+    {
+      printf(" %s %lu.%03lu ms,", mark_names[i], (unsigned long)(mark_us[i] / 1000),
+             (unsigned long)(mark_us[i] % 1000));
+    }
+    else
+    {
+      printf(" %s -,", mark_names[i]);
+    }
+  }
+  printf(" ###\r\n");
+  if (mark_us[BOOT_USB_CONNECT] > BOOT_TARGET_MS * 1000)
+  {
+    printf("### BOOT: USB CONNECT OVER THE %u MS TARGET ###\r\n", BOOT_TARGET_MS);
+  }
+
+  extract_plan_log();
+  flash_store_log();
+  return SCHED_IDLE; // once per boot
+}
+
+void boot_time_init(void)
+{
+  sched_add("boot", boot_task);
+}
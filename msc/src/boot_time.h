@@ -0,0 +1,32 @@
+#ifndef BOOT_TIME_H_
+#define BOOT_TIME_H_
+
+#include <stdint.h>
+
+// Boot timeline
+// Time stamps of the steps from power-on to the first SCSI command, in us since the timer started counting during
+// the clock setup of the SDK's runtime init, shortly after the reset vector. The timeline is logged to the debug UART
+// once the host has had time to mount the drive, along with the messages held back so the UART doesn't delay USB.
+
+#ifndef BOOT_TARGET_MS
+#define BOOT_TARGET_MS 5 // the USB pull-up must be on this soon after the clocks are set up
+#endif
+
+#define BOOT_REPORT_MS 2000 // when the timeline is logged, after the host's probing has settled
+
+typedef enum
+{
+  BOOT_MAIN,        // main() entered, runtime init done
+  BOOT_USB_CONNECT, // tusb_init() done, the pull-up tells the host a device is attached
+  BOOT_MOUNTED,     // the host has configured the device
+  BOOT_FIRST_SCSI,  // first SCSI command (INQUIRY)
+  BOOT_MARKS
+} boot_mark_t;
+
+// Record the time of a step, the first time it happens. Safe to call from a USB callback.
+void boot_mark(boot_mark_t mark);
+
+// Add the task that logs the timeline
+void boot_time_init(void);
+
+#endif /* BOOT_TIME_H_ */
@@ -0,0 +1,74 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "hardware/structs/m33.h"
+#include "cb_timing.h"
+#include "hot_path.h"
+
+typedef struct
+{
+  uint32_t count;
+  uint32_t min_cycles;
+  uint32_t max_cycles;
+  uint64_t total_cycles;
+} cb_stats_t;
+
+static char const *const cb_names[CB_TIMINGS] = {
+    [CB_READ10] = "read10",
+    [CB_WRITE10] = "write10",
+};
+
+static cb_stats_t stats[CB_TIMINGS];
+
+void cb_timing_init(void)
+{
+  m33_hw->demcr |= M33_DEMCR_TRCENA_BITS;
+  m33_hw->dwt_cyccnt = 0;
+  m33_hw->dwt_ctrl |= M33_DWT_CTRL_CYCCNTENA_BITS;
+  cb_timing_reset();
+}
+
+uint32_t HOT_FUNC(cb_timing_start)(void)
+{
+  return m33_hw->dwt_cyccnt;
+}
+
+void HOT_FUNC(cb_timing_end)(cb_timing_id_t id, uint32_t start)
+{
+  uint32_t cycles = m33_hw->dwt_cyccnt - start;
+  cb_stats_t *s = &stats[id];
+  s->count++;
+  s->total_cycles += cycles;
+  if (cycles < s->min_cycles)
+  {
+    s->min_cycles = cycles;
+  }
+  if (cycles > s->max_cycles)
+  {
+    s->max_cycles = cycles;
+  }
+}
+
+void cb_timing_print(void)
+{
+  for (int i = 0; i < CB_TIMINGS; i++)
+  {
+    cb_stats_t const *s = &stats[i];
+    if (s->count == 0)
+    {
+      continue;
+    }
+    printf("### CB %s: %lu CALLS, MIN %lu, AVG %lu, MAX %lu CYCLES (HOT_IN_RAM=%d) ###\r\n", cb_names[i],
+           (unsigned long)s->count, (unsigned long)s->min_cycles, (unsigned long)(s->total_cycles / s->count),
+           (unsigned long)s->max_cycles, HOT_IN_RAM);
+  }
+}
+
+void cb_timing_reset(void)
+{
+  memset(stats, 0, sizeof(stats));
+  for (int i = 0; i < CB_TIMINGS; i++)
+  {
+    stats[i].min_cycles = UINT32_MAX;
+  }
+}
@@ -0,0 +1,29 @@
+#ifndef CB_TIMING_H_
+#define CB_TIMING_H_
+
+#include <stdint.h>
+
+// Callback timing
+// CPU cycles spent in the READ10 and WRITE10 callbacks, counted with the Cortex-M33 cycle counter (DWT CYCCNT),
+// so the effect of code placement (hot_path.h) and of cache misses shows as min/max jitter. Logged by the stats
+// task with the scheduler's CPU load.
+
+typedef enum
+{
+  CB_READ10,
+  CB_WRITE10,
+  CB_TIMINGS
+} cb_timing_id_t;
+
+void cb_timing_init(void);
+
+// Cycle count at the start of a callback
+uint32_t cb_timing_start(void);
+
+// Account the cycles since start to a callback
+void cb_timing_end(cb_timing_id_t id, uint32_t start);
+
+void cb_timing_print(void);
+void cb_timing_reset(void);
+
+#endif /* CB_TIMING_H_ */
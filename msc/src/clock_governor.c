@@ -0,0 +1,95 @@
+#include <stdio.h>
+
+#include "bsp/board_api.h"
+#include "pico/stdlib.h"
+#include "hardware/clocks.h"
+#include "hardware/uart.h"
+#include "clock_governor.h"
+#include "sched.h"
+#include "hot_path.h"
+
+#if CLOCK_GOVERNOR
+
+static bool boosted = true; // clk_sys from the system PLL, as the runtime init left it
+static uint32_t sys_pll_hz = 0;
+static uint32_t last_activity_ms = 0;
+static int governor_task_id = -1;
+
+// Since the last log
+static uint32_t boosts = 0;
+static uint64_t low_us = 0; // time at 48 MHz
+static uint64_t low_since_us = 0;
+static uint64_t log_start_us = 0;
+
+// Both PLLs keep running, only the clk_sys mux is switched, which takes a few cycles
+static void drop(void)
+{
+  clock_configure_undivided(clk_sys, CLOCKS_CLK_SYS_CTRL_SRC_VALUE_CLKSRC_CLK_SYS_AUX,
+                            CLOCKS_CLK_SYS_CTRL_AUXSRC_VALUE_CLKSRC_PLL_USB, USB_CLK_HZ);
+  boosted = false;
+  low_since_us = time_us_64();
+}
+
+static void HOT_FUNC(boost)(void)
+{
+  clock_configure_undivided(clk_sys, CLOCKS_CLK_SYS_CTRL_SRC_VALUE_CLKSRC_CLK_SYS_AUX,
+                            CLOCKS_CLK_SYS_CTRL_AUXSRC_VALUE_CLKSRC_PLL_SYS, sys_pll_hz);
+  boosted = true;
+  boosts++;
+  low_us += time_us_64() - low_since_us;
+}
+
+// Lower the clock once the host has stopped reading and writing
+static uint32_t governor_task(void)
+{
+  if (!boosted)
+  {
+    return SCHED_IDLE; // woken by the next write
+  }
+  uint32_t idle_ms = board_millis() - last_activity_ms;
+  if (idle_ms < CLOCK_IDLE_MS)
+  {
+    return CLOCK_IDLE_MS - idle_ms;
+  }
+  drop();
+  return SCHED_IDLE;
+}
+
+void HOT_FUNC(clock_governor_activity)(bool write)
+{
+  last_activity_ms = board_millis();
+  if (write && !boosted)
+  {
+    boost();
+    sched_wake(governor_task_id);
+  }
+}
+
+void clock_governor_init(void)
+{
+  // The UART dividers are computed from clk_peri, which the runtime init takes from clk_sys
+  uart_tx_wait_blocking(uart_default);
+  clock_configure_undivided(clk_peri, 0, CLOCKS_CLK_PERI_CTRL_AUXSRC_VALUE_CLKSRC_PLL_USB, USB_CLK_HZ);
+  uart_set_baudrate(uart_default, PICO_DEFAULT_UART_BAUD_RATE);
+
+  sys_pll_hz = clock_get_hz(clk_sys);
+  last_activity_ms = board_millis();
+  log_start_us = time_us_64();
+  governor_task_id = sched_add("clock", governor_task);
+}
+
+void clock_governor_log(void)
+{
+  uint64_t now_us = time_us_64();
+  uint64_t low = low_us + (boosted ? 0 : now_us - low_since_us);
+  uint64_t elapsed_us = now_us - log_start_us;
+  printf("### CLOCK: %lu BOOSTS, %lu%% OF THE TIME AT %lu MHZ ###\r\n", (unsigned long)boosts,
+         (unsigned long)(elapsed_us ? low * 100 / elapsed_us : 0), (unsigned long)(USB_CLK_HZ / 1000000));
+
+  boosts = 0;
+  low_us = 0;
+  low_since_us = now_us;
+  log_start_us = now_us;
+}
+
+#endif
@@ -0,0 +1,54 @@
+#ifndef CLOCK_GOVERNOR_H_
+#define CLOCK_GOVERNOR_H_
+
+#include <stdbool.h>
+
+// System clock governor
+// The MSC is idle between the instrument's saves, but runs at the full system clock all the time, on the power the
+// PC's VBUS gives both boards. With CLOCK_GOVERNOR=1, clk_sys is switched to the 48 MHz USB PLL once no READ10 or
+// WRITE10 has come for CLOCK_IDLE_MS. The first WRITE10 after that switches it back to the system PLL, before the
+// sectors are parsed, so the CSV extraction always runs at full speed. The system PLL is left running, so switching
+// back is only a glitchless mux change, quick enough for the WRITE10 callback, rather than a PLL restart that waits
+// for lock. Reads are served at 48 MHz, which is plenty to copy sectors. Other commands, such as the TEST UNIT READY
+// the host polls with, don't count.
+//
+// clk_usb stays on the USB PLL, and clk_peri is moved there at init too, so the UART baud rates don't change with
+// clk_sys.
+
+#ifndef CLOCK_GOVERNOR
+#define CLOCK_GOVERNOR 0 // 1: lower the system clock while the host isn't reading or writing
+#endif
+
+#ifndef CLOCK_IDLE_MS
+#define CLOCK_IDLE_MS 2000
+#endif
+
+#if CLOCK_GOVERNOR
+
+// Move clk_peri to the USB PLL and add the task that lowers the clock. Before the UART to the HID is set up.
+void clock_governor_init(void);
+
+// A READ10 or WRITE10 arrived. A write raises the clock at once.
+void clock_governor_activity(bool write);
+
+// Log the clock switches
+void clock_governor_log(void);
+
+#else
+
+static inline void clock_governor_init(void)
+{
+}
+
+static inline void clock_governor_activity(bool write)
+{
+  (void)write;
+}
+
+static inline void clock_governor_log(void)
+{
+}
+
+#endif
+
+#endif /* CLOCK_GOVERNOR_H_ */
@@ -0,0 +1,184 @@
+#include <string.h>
+
+#include "column_stats.h"
+
+static uint32_t const powers_of_10[FIXED_MAX_DECIMALS + 1] = {
+    1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000,
+};
+
+// (a * b) >> 24 without overflowing the product, saturated to 64 bits
+static uint64_t mul_shr24(uint64_t a, uint64_t b)
+{
+  uint64_t al = (uint32_t)a;
+  uint64_t ah = a >> 32;
+  uint64_t bl = (uint32_t)b;
+  uint64_t bh = b >> 32;
+  uint64_t ll = al * bl;
+  uint64_t lh = al * bh;
+  uint64_t hl = ah * bl;
+  uint64_t mid = (ll >> 32) + (uint32_t)lh + (uint32_t)hl;
+  uint64_t lo = (mid << 32) | (uint32_t)ll;
+  uint64_t hi = ah * bh + (lh >> 32) + (hl >> 32) + (mid >> 32);
+  if (hi >> 24)
+  {
+    return UINT64_MAX;
+  }
+  return (hi << 40) | (lo >> 24);
+}
+
+static uint64_t add_sat(uint64_t a, uint64_t b)
+{
+  return a + b < a ? UINT64_MAX : a + b;
+}
+
+static uint32_t isqrt64(uint64_t n)
+{
+  uint64_t root = 0;
+  uint64_t bit = 1ull << 62;
+  while (bit > n)
+    bit >>= 2;
+  while (bit)
+  {
+    if (n >= root + bit)
+    {
+      n -= root + bit;
+      root = (root >> 1) + bit;
+    }
+    else
+    {
+      root >>= 1;
+    }
+    bit >>= 2;
+  }
+  return (uint32_t)root;
+}
+
+void column_stats_init(column_stats_t *stats)
+{
+  memset(stats, 0, sizeof(*stats));
+}
+
+// Bring the statistics to more decimals
+static bool raise_decimals(column_stats_t *stats, uint8_t decimals)
+{
+  uint32_t mul = powers_of_10[decimals - stats->decimals];
+  if (stats->min < -FIXED_MAX_MANTISSA / (int32_t)mul || stats->max > FIXED_MAX_MANTISSA / (int32_t)mul)
+  {
+    return false;
+  }
+  stats->min *= (int32_t)mul;
+  stats->max *= (int32_t)mul;
+  stats->mean_q16 *= mul;
+  for (uint8_t i = 0; i < 2; i++)
+  {
+    stats->m2_q8 = stats->m2_q8 > UINT64_MAX / mul ? UINT64_MAX : stats->m2_q8 * mul;
+  }
+  stats->decimals = decimals;
+  return true;
+}
+
+bool column_stats_add(column_stats_t *stats, fixed_t const *value)
+{
+  fixed_t x = *value;
+  if (stats->count == 0)
+  {
+    stats->decimals = x.decimals;
+    stats->min = x.mantissa;
+    stats->max = x.mantissa;
+  }
+  else if (x.decimals > stats->decimals)
+  {
+    column_stats_t raised = *stats;
+    if (!raise_decimals(&raised, x.decimals))
+    {
+      return false;
+    }
+    *stats = raised;
+  }
+  else if (!fixed_rescale(&x, stats->decimals))
+  {
+    return false;
+  }
+
+  stats->count++;
+  if (x.mantissa < stats->min)
+  {
+    stats->min = x.mantissa;
+  }
+  if (x.mantissa > stats->max)
+  {
+    stats->max = x.mantissa;
+  }
+
+  // Welford: the two deviations always have the same sign, so their product is added as a magnitude
+  int64_t x_q16 = (int64_t)x.mantissa << 16;
+  int64_t delta = x_q16 - stats->mean_q16;
+  stats->mean_q16 += delta / (int64_t)stats->count;
+  int64_t delta2 = x_q16 - stats->mean_q16;
+  uint64_t d1 = (uint64_t)(delta < 0 ? -delta : delta);
+  uint64_t d2 = (uint64_t)(delta2 < 0 ? -delta2 : delta2);
+  stats->m2_q8 = add_sat(stats->m2_q8, mul_shr24(d1, d2));
+  return true;
+}
+
+uint32_t column_stats_format(column_stats_t const *stats, uint8_t decimals, char point, char *text, uint32_t size)
+{
+  if (stats->count == 0 || stats->m2_q8 == UINT64_MAX)
+  {
+    return 0;
+  }
+
+  // The standard deviation is the square root of the Q8 variance, so it comes out with 4 fraction bits
+  uint64_t var_q8 = stats->count > 1 ? stats->m2_q8 / (stats->count - 1) : 0;
+  uint64_t sd = ((uint64_t)isqrt64(var_q8) + 8) >> 4;
+  if (sd > FIXED_MAX_MANTISSA)
+  {
+    return 0;
+  }
+  // Rounded half away from zero, like fixed_rescale()
+  int64_t mean = stats->mean_q16 < 0 ? -((-stats->mean_q16 + 0x8000) >> 16) : (stats->mean_q16 + 0x8000) >> 16;
+  fixed_t values[4] = {
+      {.mantissa = (int32_t)mean, .decimals = stats->decimals},
+      {.mantissa = stats->min, .decimals = stats->decimals},
+      {.mantissa = stats->max, .decimals = stats->decimals},
+      {.mantissa = (int32_t)sd, .decimals = stats->decimals},
+  };
+
+  uint32_t len = 0;
+  uint32_t count = stats->count;
+  char digits[10];
+  uint32_t n = 0;
+  do
+  {
+    digits[n++] = (char)('0' + count % 10);
+    count /= 10;
+  } while (count > 0);
+  if (n >= size)
+  {
+    return 0;
+  }
+  while (n > 0)
+  {
+    text[len++] = digits[--n];
+  }
+
+  for (uint32_t i = 0; i < 4; i++)
+  {
+    if (decimals <= FIXED_MAX_DECIMALS && !fixed_rescale(&values[i], decimals))
+    {
+      return 0;
+    }
+    if (len + 1 >= size)
+    {
+      return 0;
+    }
+    text[len++] = '\t';
+    uint32_t written = fixed_format(&values[i], point, text + len, size - len);
+    if (written == 0)
+    {
+      return 0;
+    }
+    len += written;
+  }
+  return len;
+}
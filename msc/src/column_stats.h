@@ -0,0 +1,36 @@
+#ifndef COLUMN_STATS_H_
+#define COLUMN_STATS_H_
+
+#include <stdint.h>
+
+#include "fixed_point.h"
+
+// Column statistics
+// Count, mean, minimum, maximum and standard deviation of the numbers in a column, updated one value at a time with
+// Welford's algorithm, so a file of any length is summarised in one pass and constant memory. Everything is integer
+// arithmetic on the fixed-point values of fixed_point.h: the mean is kept with 16 extra fraction bits and the sum of
+// squared deviations with 8, in units of the last decimal.
+
+typedef struct
+{
+  uint32_t count;
+  uint8_t decimals; // of all the values below, raised when a value with more decimals arrives
+  int32_t min;
+  int32_t max;
+  int64_t mean_q16;
+  uint64_t m2_q8; // saturates, far beyond any real spread of readings
+} column_stats_t;
+
+void column_stats_init(column_stats_t *stats);
+
+// Add a value. Returns false, leaving the statistics as they were, if the value can't be brought to the same
+// decimals as the others without overflowing.
+bool column_stats_add(column_stats_t *stats, fixed_t const *value);
+
+// Write the summary as one line of tab separated values: count, mean, minimum, maximum and sample standard deviation.
+// decimals is the number of decimals of the values written, or the decimals of the column if it's above
+// FIXED_MAX_DECIMALS. Returns the length of the text, or 0 if it doesn't fit in size, the column had no numbers or
+// their spread is too large for the standard deviation.
+uint32_t column_stats_format(column_stats_t const *stats, uint8_t decimals, char point, char *text, uint32_t size);
+
+#endif /* COLUMN_STATS_H_ */
@@ -0,0 +1,117 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "disk_layout.h"
+#include "config_file.h"
+#include "extract_plan.h"
+#include "flash_store.h"
+#include "msc_lun.h"
+#include "sched.h"
+#include "hot_path.h"
+
+// The last cluster of the volume holds the file, well away from where the host allocates new files. Its root
+// directory entry is the one gen_disk.py leaves free, at DISK_CONFIG_DIR_OFFSET.
+
+// Same time stamp as the other entries of the volume
+static uint8_t const config_entry[32] = {
+    'C', 'O', 'N', 'F', 'I', 'G', ' ', ' ', 'T', 'X', 'T', 0x20, // name, archive attribute
+    0x00, 0x00,                                                  // reserved, creation time in 10 ms
+    (uint8_t)DISK_FAT_TIME, (uint8_t)(DISK_FAT_TIME >> 8),       // creation time
+    (uint8_t)DISK_FAT_DATE, (uint8_t)(DISK_FAT_DATE >> 8),       // creation date
+    (uint8_t)DISK_FAT_DATE, (uint8_t)(DISK_FAT_DATE >> 8),       // access date
+    0x00, 0x00,                                                  // high cluster
+    (uint8_t)DISK_FAT_TIME, (uint8_t)(DISK_FAT_TIME >> 8),       // modification time
+    (uint8_t)DISK_FAT_DATE, (uint8_t)(DISK_FAT_DATE >> 8),       // modification date
+    0x00, 0x00,                                                  // first cluster, the last one of the LUN
+    0x00, 0x00, 0x00, 0x00,                                      // size, filled in from the text
+};
+
+typedef struct
+{
+  char text[DISK_BLOCK_SIZE];
+  uint32_t text_len;
+
+  // Compiled from the host's file, waiting to be stored by the config task
+  extract_plan_t new_plan;
+  volatile bool has_new_plan;
+} config_file_t;
+
+static config_file_t files[MSC_LUNS];
+static int config_task_id = -1;
+
+static void format_text(uint8_t lun)
+{
+  files[lun].text_len = extract_plan_format(extract_plan(lun), files[lun].text, sizeof(files[lun].text));
+}
+
+// Erasing and programming the flash takes tens of ms with interrupts disabled, too long for a USB callback
+static uint32_t config_task(void)
+{
+  for (uint8_t lun = 0; lun < MSC_LUNS; lun++)
+  {
+    if (files[lun].has_new_plan)
+    {
+      files[lun].has_new_plan = false;
+      extract_plan_store(lun, &files[lun].new_plan);
+      format_text(lun);
+    }
+  }
+  return SCHED_IDLE; // woken by config_file_write()
+}
+
+void config_file_init(void)
+{
+  for (uint8_t lun = 0; lun < MSC_LUNS; lun++)
+  {
+    format_text(lun);
+  }
+  config_task_id = sched_add("config", config_task);
+}
+
+void HOT_FUNC(config_file_read)(uint8_t lun, uint32_t lba, uint8_t *buffer, uint32_t bufsize)
+{
+  config_file_t const *file = &files[lun];
+  uint32_t const cluster = msc_lun_cluster_count(lun) + 1;
+  uint32_t const fat_lba = DISK_FAT_LBA + cluster * 2 / DISK_BLOCK_SIZE; // FAT sector with the file's entry
+  uint32_t const fat_offset = cluster * 2 % DISK_BLOCK_SIZE;
+
+  for (uint32_t off = 0; off + DISK_BLOCK_SIZE <= bufsize; off += DISK_BLOCK_SIZE, lba++)
+  {
+    uint8_t *sector = buffer + off;
+    if (flash_store_holds(lun, lba))
+    {
+      continue; // the host's own copy, which may have moved, deleted or overwritten the file
+    }
+    if (lba == DISK_ROOT_DIR_LBA)
+    {
+      uint8_t *e = &sector[DISK_CONFIG_DIR_OFFSET];
+      memcpy(e, config_entry, sizeof(config_entry));
+      e[26] = (uint8_t)cluster;
+      e[27] = (uint8_t)(cluster >> 8);
+      e[28] = (uint8_t)file->text_len;
+      e[29] = (uint8_t)(file->text_len >> 8);
+    }
+    else if (lba == fat_lba || lba == fat_lba + DISK_FAT_SECTORS)
+    {
+      sector[fat_offset] = 0xff; // end of chain, in both FATs
+      sector[fat_offset + 1] = 0xff;
+    }
+    else if (lba == DISK_CLUSTER_LBA(cluster))
+    {
+      memcpy(sector, file->text, file->text_len);
+    }
+  }
+}
+
+void config_file_write(uint8_t lun, uint8_t const *data, uint32_t size)
+{
+  extract_plan_t plan;
+  if (!extract_plan_compile(lun, data, size, &plan))
+  {
+    printf("### CONFIG: LUN=%u REJECTED ###\r\n", lun);
+    return;
+  }
+  files[lun].new_plan = plan;
+  files[lun].has_new_plan = true;
+  sched_wake(config_task_id);
+}
@@ -0,0 +1,24 @@
+#ifndef CONFIG_FILE_H_
+#define CONFIG_FILE_H_
+
+#include <stdint.h>
+
+// CONFIG.TXT
+// The static volume is extended with a root directory entry, FAT entries and a data cluster that present the active
+// extraction plan (extract_plan.h) as text. A CONFIG.TXT written back by the host arrives through whole-file capture,
+// is compiled into a new plan and stored in flash by a task, outside the USB callbacks. Every LUN has its own.
+// With FLASH_STORE=1, a sector the host has written is served as the host wrote it, without the patch.
+// Without FILE_CAPTURE, the file isn't shown at all.
+
+#define CONFIG_FILE_NAME "CONFIG.TXT"
+
+// Generate the text of the active plans and register the task that stores new plans
+void config_file_init(void);
+
+// Patch the sectors read by the host with the CONFIG.TXT entry, its FAT chain and its contents
+void config_file_read(uint8_t lun, uint32_t lba, uint8_t *buffer, uint32_t bufsize);
+
+// Compile the contents of a CONFIG.TXT written by the host. The plan is stored later by the config task.
+void config_file_write(uint8_t lun, uint8_t const *data, uint32_t size);
+
+#endif /* CONFIG_FILE_H_ */
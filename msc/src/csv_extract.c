@@ -0,0 +1,289 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "csv_extract.h"
+#include "hot_path.h"
+
+// The parser is always inlined into a kernel per dialect (CSV_KERNEL below), where delim and quoted are constants.
+// The compiler drops the quote handling from the unquoted kernels, so the plain scan compares each byte with
+// three constants and nothing else.
+static inline __attribute__((always_inline)) int32_t extract(uint8_t const *buffer, uint32_t bufsize, int row,
+                                                             int col, uint8_t const **field, uint8_t const delim,
+                                                             bool const quoted)
+{
+  int cur_row = 0;
+  int cur_col = 0;
+  uint8_t const *pos = buffer;
+  uint8_t const *end = buffer + bufsize;
+  while (pos < end)
+  {
+    uint8_t const *start = pos;
+    uint8_t const *stop;
+    if (quoted && *pos == '"')
+    {
+      // Find the closing quote, "" is an escaped quote
+      start = ++pos;
+      while (pos < end && !(*pos == '"' && (pos + 1 == end || pos[1] != '"')))
+      {
+        pos += (*pos == '"') ? 2 : 1;
+      }
+      if (pos >= end)
+      {
+        return -1; // the field goes on in the next sector
+      }
+      stop = pos++;
+      while (pos < end && *pos != delim && *pos != '\n' && *pos != '\0')
+      {
+        pos++; // text after the closing quote isn't part of the field
+      }
+    }
+    else
+    {
+      while (pos < end && *pos != delim && *pos != '\n' && *pos != '\0')
+      {
+        pos++;
+      }
+      stop = (pos < end && *pos == '\n' && pos > start && pos[-1] == '\r') ? pos - 1 : pos;
+    }
+
+    if (cur_row == row && cur_col == col)
+    {
+      *field = start;
+      return (int32_t)(stop - start);
+    }
+    if (pos == end || *pos == '\0')
+    {
+      return -1; // the end of the text
+    }
+    if (*pos == '\n')
+    {
+      if (++cur_row > row)
+      {
+        return -1;
+      }
+      cur_col = 0;
+    }
+    else
+    {
+      cur_col++;
+    }
+    pos++;
+  }
+  return -1;
+}
+
+#define CSV_KERNEL(name, delim, quoted)                                                                                \
+  static int32_t HOT_FUNC(name)(uint8_t const *buffer, uint32_t bufsize, int row, int col, uint8_t const **field)      \
+  {                                                                                                                    \
+    return extract(buffer, bufsize, row, col, field, delim, quoted);                                                   \
+  }
+
+CSV_KERNEL(extract_comma, ',', false)
+CSV_KERNEL(extract_comma_quoted, ',', true)
+CSV_KERNEL(extract_semicolon, ';', false)
+CSV_KERNEL(extract_semicolon_quoted, ';', true)
+CSV_KERNEL(extract_tab, '\t', false)
+CSV_KERNEL(extract_tab_quoted, '\t', true)
+
+int32_t HOT_FUNC(csv_extract_field)(uint8_t const *buffer, uint32_t bufsize, int row, int col, uint8_t delim,
+                                    uint8_t const **field)
+{
+  // Identify a potential CSV file by checking for the delimiter
+  if (bufsize == 0 || memchr(buffer, delim, bufsize) == NULL)
+  {
+    return -1;
+  }
+
+  // The quoted kernels are only needed when there is a quote in the block
+  bool quoted = memchr(buffer, '"', bufsize) != NULL;
+  switch (delim)
+  {
+  case ',':
+    return quoted ? extract_comma_quoted(buffer, bufsize, row, col, field)
+                  : extract_comma(buffer, bufsize, row, col, field);
+  case ';':
+    return quoted ? extract_semicolon_quoted(buffer, bufsize, row, col, field)
+                  : extract_semicolon(buffer, bufsize, row, col, field);
+  case '\t':
+    return quoted ? extract_tab_quoted(buffer, bufsize, row, col, field)
+                  : extract_tab(buffer, bufsize, row, col, field);
+  default:
+    return -1;
+  }
+}
+
+//--------------------------------------------------------------------+
+// Streaming scan
+//--------------------------------------------------------------------+
+
+enum
+{
+  SCAN_FIELD_START,
+  SCAN_UNQUOTED,
+  SCAN_QUOTED,
+  SCAN_QUOTE, // a quote in a quoted field, either escaped or the closing one
+  SCAN_AFTER, // after the closing quote
+};
+
+void csv_scan_init(csv_scan_t *scan, uint8_t delim, uint16_t col)
+{
+  memset(scan, 0, sizeof(*scan));
+  scan->delim = delim;
+  scan->col = col;
+}
+
+static void scan_append(csv_scan_t *scan, uint8_t c)
+{
+  if (scan->cur_col != scan->col)
+  {
+    return;
+  }
+  if (scan->len < CSV_SCAN_FIELD_MAX)
+  {
+    scan->field[scan->len++] = c;
+  }
+  else if (c == '\r' && !scan->truncated && !scan->cr_pending)
+  {
+    scan->cr_pending = true; // the field may end here, with a CRLF
+  }
+  else
+  {
+    scan->truncated = true;
+  }
+}
+
+static void scan_end_field(csv_scan_t *scan, csv_scan_cb_t cb, void *ctx)
+{
+  if (scan->cur_col == scan->col)
+  {
+    cb(ctx, scan->row, scan->field, scan->len, scan->truncated);
+  }
+  scan->len = 0;
+  scan->truncated = false;
+  scan->cr_pending = false;
+  scan->state = SCAN_FIELD_START;
+}
+
+void csv_scan_feed(csv_scan_t *scan, uint8_t const *data, uint32_t len, csv_scan_cb_t cb, void *ctx)
+{
+  for (uint8_t const *p = data; p < data + len && !scan->done; p++)
+  {
+    uint8_t c = *p;
+    if (scan->state == SCAN_QUOTED)
+    {
+      if (c == '"')
+      {
+        scan->state = SCAN_QUOTE;
+      }
+      else
+      {
+        scan_append(scan, c);
+      }
+      continue;
+    }
+    if (scan->state == SCAN_QUOTE)
+    {
+      if (c == '"')
+      {
+        scan_append(scan, c); // escaped
+        scan->state = SCAN_QUOTED;
+        continue;
+      }
+      scan->state = SCAN_AFTER;
+    }
+
+    if (c == scan->delim || c == '\n')
+    {
+      if (scan->cr_pending && c != '\n')
+      {
+        scan->truncated = true;
+      }
+      else if (c == '\n' && scan->state == SCAN_UNQUOTED && !scan->cr_pending && scan->len > 0 &&
+               scan->field[scan->len - 1] == '\r' && !scan->truncated)
+      {
+        scan->len--;
+      }
+      scan_end_field(scan, cb, ctx);
+      if (c == '\n')
+      {
+        scan->row++;
+        scan->cur_col = 0;
+      }
+      else
+      {
+        scan->cur_col++;
+      }
+    }
+    else if (c == '\0')
+    {
+      scan->done = true;
+    }
+    else if (scan->state == SCAN_FIELD_START && c == '"')
+    {
+      scan->state = SCAN_QUOTED;
+    }
+    else if (scan->state != SCAN_AFTER)
+    {
+      scan->state = SCAN_UNQUOTED;
+      scan_append(scan, c);
+    }
+  }
+}
+
+void csv_scan_end(csv_scan_t *scan, csv_scan_cb_t cb, void *ctx)
+{
+  if (scan->state != SCAN_FIELD_START || scan->cur_col > 0)
+  {
+    scan_end_field(scan, cb, ctx);
+  }
+  scan->done = true;
+}
+
+static void tail_field_cb(void *ctx, uint32_t row, uint8_t const *field, uint32_t len, bool truncated)
+{
+  csv_tail_t *tail = ctx;
+  if (len == 0)
+  {
+    return;
+  }
+  csv_tail_field_t *f = &tail->fields[tail->next];
+  f->row = row;
+  f->len = (uint8_t)len;
+  f->truncated = truncated;
+  memcpy(f->field, field, len);
+  tail->next = (uint8_t)((tail->next + 1) % tail->rows);
+  if (tail->count < tail->rows)
+  {
+    tail->count++;
+  }
+}
+
+void csv_tail_init(csv_tail_t *tail, uint8_t delim, uint16_t col, uint8_t rows)
+{
+  csv_scan_init(&tail->scan, delim, col);
+  tail->rows = rows == 0 ? 1 : rows > CSV_TAIL_ROWS_MAX ? CSV_TAIL_ROWS_MAX : rows;
+  tail->count = 0;
+  tail->next = 0;
+}
+
+void csv_tail_feed(csv_tail_t *tail, uint8_t const *data, uint32_t len)
+{
+  csv_scan_feed(&tail->scan, data, len, tail_field_cb, tail);
+}
+
+void csv_tail_end(csv_tail_t *tail)
+{
+  csv_scan_end(&tail->scan, tail_field_cb, tail);
+}
+
+uint32_t csv_tail_count(csv_tail_t const *tail)
+{
+  return tail->count;
+}
+
+csv_tail_field_t const *csv_tail_field(csv_tail_t const *tail, uint32_t n)
+{
+  uint32_t oldest = tail->count < tail->rows ? 0 : tail->next;
+  return &tail->fields[(oldest + n) % tail->rows];
+}
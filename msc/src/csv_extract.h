@@ -0,0 +1,86 @@
+#ifndef CSV_EXTRACT_H_
+#define CSV_EXTRACT_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Search a block of CSV text for the field at the given row and column.
+// This is the parsing kernel behind tud_msc_write10_cb. It has no dependency on the pico sdk, so that it
+// can also be built and benchmarked on a host PC (see the host folder).
+// The delimiter is ',', ';' or '\t'. A block without the delimiter is assumed not to be CSV and is skipped.
+// Fields may be quoted as in RFC 4180: a quoted field can hold delimiters and line breaks, and the field returned is
+// the text between the quotes (an escaped "" is left as it is). A CR before the line break is not part of the field.
+// Returns the length of the field and points *field at its first character, or -1 if the field was not found.
+int32_t csv_extract_field(uint8_t const *buffer, uint32_t bufsize, int row, int col, uint8_t delim,
+                          uint8_t const **field);
+
+// Streaming scan of one column
+// Unlike csv_extract_field, the scanner keeps its state between calls, so a file can be fed in pieces (a sector at a
+// time) and every row is seen in one pass. The fields of the column are copied to a small buffer, unquoted and with
+// "" unescaped, and handed to a callback as each one ends.
+
+#define CSV_SCAN_FIELD_MAX 32 // longer fields are cut short, and flagged to the callback
+
+typedef void (*csv_scan_cb_t)(void *ctx, uint32_t row, uint8_t const *field, uint32_t len, bool truncated);
+
+typedef struct
+{
+  uint8_t delim;
+  uint16_t col; // the column to hand to the callback
+  uint32_t row; // position of the next byte
+  uint16_t cur_col;
+  uint8_t state;
+  bool done; // a NUL was seen, the rest is sector padding
+  bool truncated;
+  bool cr_pending; // a CR that didn't fit after a full field, cut only if no line break follows
+  uint8_t len;
+  uint8_t field[CSV_SCAN_FIELD_MAX];
+} csv_scan_t;
+
+void csv_scan_init(csv_scan_t *scan, uint8_t delim, uint16_t col);
+
+// Scan more of the file
+void csv_scan_feed(csv_scan_t *scan, uint8_t const *data, uint32_t len, csv_scan_cb_t cb, void *ctx);
+
+// End of the file, for a last line without a line break
+void csv_scan_end(csv_scan_t *scan, csv_scan_cb_t cb, void *ctx);
+
+// Tail of one column
+// Keeps the fields of the column in the last few rows only, as a file streams through a csv_scan_t. An instrument
+// that appends a row per measurement has its newest readings there, and they cost the same memory however long the
+// file grows. Rows with an empty field in the column, such as a blank last line, don't count.
+
+#define CSV_TAIL_ROWS_MAX 8
+
+typedef struct
+{
+  uint32_t row;
+  uint8_t len;
+  bool truncated;
+  uint8_t field[CSV_SCAN_FIELD_MAX];
+} csv_tail_field_t;
+
+typedef struct
+{
+  csv_scan_t scan;
+  uint8_t rows;  // fields kept, up to CSV_TAIL_ROWS_MAX
+  uint8_t count; // fields held so far, up to rows
+  uint8_t next;  // where the next field goes in the ring
+  csv_tail_field_t fields[CSV_TAIL_ROWS_MAX];
+} csv_tail_t;
+
+void csv_tail_init(csv_tail_t *tail, uint8_t delim, uint16_t col, uint8_t rows);
+
+// Scan more of the file
+void csv_tail_feed(csv_tail_t *tail, uint8_t const *data, uint32_t len);
+
+// End of the file, for a last line without a line break
+void csv_tail_end(csv_tail_t *tail);
+
+// Number of fields held, at most rows
+uint32_t csv_tail_count(csv_tail_t const *tail);
+
+// Field n of those held, the oldest first
+csv_tail_field_t const *csv_tail_field(csv_tail_t const *tail, uint32_t n);
+
+#endif /* CSV_EXTRACT_H_ */
@@ -0,0 +1,67 @@
+#include <string.h>
+
+#include "disk_layout.h"
+#include "disk_image.h"
+#include "hot_path.h"
+
+typedef struct
+{
+  uint32_t lba;
+  uint32_t offset; // of the sector's runs in disk_image_payload
+} disk_image_index_t;
+
+// disk_image_index and disk_image_payload, in SRAM with the read path
+#include "disk_image_data.h"
+
+// Index of a stored sector, or -1 if the sector is all zeros
+static int HOT_FUNC(find_sector)(uint32_t lba)
+{
+  int lo = 0;
+  int hi = DISK_IMAGE_SECTORS - 1;
+  while (lo <= hi)
+  {
+    int mid = (lo + hi) / 2;
+    if (disk_image_index[mid].lba == lba)
+    {
+      return mid;
+    }
+    if (disk_image_index[mid].lba < lba)
+    {
+      lo = mid + 1;
+    }
+    else
+    {
+      hi = mid - 1;
+    }
+  }
+  return -1;
+}
+
+void HOT_FUNC(disk_image_read)(uint32_t lba, uint8_t *sector)
+{
+  int i = find_sector(lba);
+  if (i < 0)
+  {
+    memset(sector, 0, DISK_BLOCK_SIZE);
+    return;
+  }
+
+  // Control byte c: c + 1 literal bytes follow if c < 0x80, otherwise the next byte is repeated c - 0x80 + 2 times
+  uint8_t const *p = &disk_image_payload[disk_image_index[i].offset];
+  uint32_t n = 0;
+  while (n < DISK_BLOCK_SIZE)
+  {
+    uint32_t c = *p++;
+    if (c < 0x80)
+    {
+      memcpy(&sector[n], p, c + 1);
+      p += c + 1;
+      n += c + 1;
+    }
+    else
+    {
+      memset(&sector[n], *p++, c - 0x80 + 2);
+      n += c - 0x80 + 2;
+    }
+  }
+}
@@ -0,0 +1,14 @@
+#ifndef DISK_IMAGE_H_
+#define DISK_IMAGE_H_
+
+#include <stdint.h>
+
+// Sectors of the FAT16 volume
+// The volume is formatted at build time by host/gen_disk.py, with the geometry, label and directories set by
+// DISK_IMAGE_ARGS in common/disk_image.cmake, shared with the host tools. Only the sectors that aren't all zeros are
+// kept in flash, run-length encoded, with a sorted index of their LBAs. They are decoded as the host reads them.
+
+// Decode a sector of the volume into sector, DISK_BLOCK_SIZE bytes
+void disk_image_read(uint32_t lba, uint8_t *sector);
+
+#endif /* DISK_IMAGE_H_ */
@@ -0,0 +1,23 @@
+#ifndef DISK_LAYOUT_H_
+#define DISK_LAYOUT_H_
+
+#include <stdint.h>
+
+// Geometry of the volume, generated with the disk image by host/gen_disk.py (see common/disk_image.cmake):
+// DISK_BLOCK_NUM, DISK_SECTORS_PER_CLUSTER, DISK_FAT_LBA, DISK_FAT_SECTORS, DISK_FAT_NUM and DISK_ROOT_DIR_SECTORS,
+// DISK_CONFIG_DIR_OFFSET, the root directory entry kept free for CONFIG.TXT (config_file.h), and DISK_LABEL (11
+// characters padded with spaces) and DISK_SERIAL, the volume label and serial number of the first LUN (msc_lun.h),
+// and DISK_FAT_TIME and DISK_FAT_DATE, the time stamp of the directory entries in FAT format
+#include "disk_geometry.h"
+
+#define DISK_BLOCK_SIZE 512 // Standard block size
+
+// Layout of the FAT16 volume, the first FAT is followed by its copies
+#define DISK_ROOT_DIR_LBA (DISK_FAT_LBA + DISK_FAT_NUM * DISK_FAT_SECTORS) // 132 by default
+#define DISK_DATA_LBA (DISK_ROOT_DIR_LBA + DISK_ROOT_DIR_SECTORS) // 164 by default, first sector of cluster 2
+#define DISK_CLUSTER_COUNT ((DISK_BLOCK_NUM - DISK_DATA_LBA) / DISK_SECTORS_PER_CLUSTER) // clusters 2 to 16344 by default
+
+// First sector of a data cluster
+#define DISK_CLUSTER_LBA(cluster) (DISK_DATA_LBA + ((uint32_t)(cluster) - 2) * DISK_SECTORS_PER_CLUSTER)
+
+#endif /* DISK_LAYOUT_H_ */
@@ -0,0 +1,411 @@
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "pico/stdlib.h"
+#include "hardware/flash.h"
+#include "hardware/sync.h"
+#include "extract_plan.h"
+#include "record_dedup.h"
+#include "msc_lun.h"
+#include "fixed_point.h"
+#include "csv_extract.h"
+
+// The last sector of the flash is reserved for the plans, one page per LUN
+#define PLAN_FLASH_OFFSET (PICO_FLASH_SIZE_BYTES - FLASH_SECTOR_SIZE)
+#define PLAN_STORED(lun) ((extract_plan_t const *)(XIP_BASE + PLAN_FLASH_OFFSET + (lun) * FLASH_PAGE_SIZE))
+
+static_assert(MSC_LUN_MAX * FLASH_PAGE_SIZE <= FLASH_SECTOR_SIZE, "a page per LUN");
+
+#define PLAN_MAX_VALUE 9999
+
+static extract_plan_t default_plans[MSC_LUNS];
+static extract_plan_t const *active_plans[MSC_LUNS];
+static extract_plan_t ram_plans[MSC_LUNS]; // used while the flash sector is rewritten
+
+static uint32_t plan_crc(extract_plan_t const *plan)
+{
+  return dedup_crc32(0, (uint8_t const *)plan, offsetof(extract_plan_t, crc));
+}
+
+static bool plan_valid(extract_plan_t const *plan)
+{
+  return plan->magic == PLAN_MAGIC && plan->version == PLAN_VERSION && plan->length == sizeof(extract_plan_t) &&
+         plan->crc == plan_crc(plan);
+}
+
+// The delimiter as it is written in the config text. A tab is spelled out, because values are trimmed of tabs.
+static char const *delim_name(uint8_t delim)
+{
+  return delim == '\t' ? "TAB" : delim == ';' ? ";" : ",";
+}
+
+// The row as it is written in the config text
+static char const *row_name(uint16_t row, char *buf, uint32_t size)
+{
+  if (row == PLAN_ROW_LAST)
+  {
+    return "LAST";
+  }
+  snprintf(buf, size, "%u", row);
+  return buf;
+}
+
+// The decimals as they are written in the config text
+static char const *decimals_name(uint8_t decimals, char *buf)
+{
+  if (decimals == PLAN_DECIMALS_AUTO)
+  {
+    return "AUTO";
+  }
+  if (decimals == PLAN_DECIMALS_TEXT)
+  {
+    return "TEXT";
+  }
+  buf[0] = (char)('0' + decimals);
+  buf[1] = '\0';
+  return buf;
+}
+
+// The stored plan of a LUN, or its defaults
+static extract_plan_t const *load_plan(uint8_t lun)
+{
+  return plan_valid(PLAN_STORED(lun)) ? PLAN_STORED(lun) : &default_plans[lun];
+}
+
+void extract_plan_init(void)
+{
+  for (uint8_t lun = 0; lun < MSC_LUNS; lun++)
+  {
+    default_plans[lun] = (extract_plan_t){
+        .magic = PLAN_MAGIC,
+        .version = PLAN_VERSION,
+        .length = sizeof(extract_plan_t),
+        .row = msc_luns[lun].default_row,
+        .col = msc_luns[lun].default_col,
+        .delim = PLAN_DEFAULT_DELIM,
+        .decimals = PLAN_DEFAULT_DECIMALS,
+        .point = PLAN_DEFAULT_POINT,
+        .rows = PLAN_DEFAULT_ROWS,
+    };
+    active_plans[lun] = load_plan(lun);
+  }
+}
+
+void extract_plan_log(void)
+{
+  char buf[6];
+  for (uint8_t lun = 0; lun < MSC_LUNS; lun++)
+  {
+    printf("### PLAN: LUN=%u ROW=%s COL=%u DELIM=%s (%s) ###\r\n", lun,
+           row_name(active_plans[lun]->row, buf, sizeof(buf)), active_plans[lun]->col,
+           delim_name(active_plans[lun]->delim), active_plans[lun] == PLAN_STORED(lun) ? "flash" : "default");
+  }
+}
+
+extract_plan_t const *extract_plan(uint8_t lun)
+{
+  return active_plans[lun];
+}
+
+//--------------------------------------------------------------------+
+// Config text
+//--------------------------------------------------------------------+
+
+static bool key_is(uint8_t const *key, uint32_t len, char const *name)
+{
+  if (len != strlen(name))
+  {
+    return false;
+  }
+  for (uint32_t i = 0; i < len; i++)
+  {
+    char c = (char)key[i];
+    if (c >= 'a' && c <= 'z')
+    {
+      c = (char)(c - 'a' + 'A');
+    }
+    if (c != name[i])
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+static bool parse_number(uint8_t const *p, uint32_t len, uint16_t *value)
+{
+  uint32_t n = 0;
+  if (len == 0)
+  {
+    return false;
+  }
+  for (uint32_t i = 0; i < len; i++)
+  {
+    if (p[i] < '0' || p[i] > '9')
+    {
+      return false;
+    }
+    n = n * 10 + (p[i] - '0');
+    if (n > PLAN_MAX_VALUE)
+    {
+      return false;
+    }
+  }
+  *value = (uint16_t)n;
+  return true;
+}
+
+static bool parse_row(uint8_t const *p, uint32_t len, uint16_t *row)
+{
+  if (key_is(p, len, "LAST"))
+  {
+    *row = PLAN_ROW_LAST;
+    return true;
+  }
+  return parse_number(p, len, row);
+}
+
+static bool parse_rows(uint8_t const *p, uint32_t len, uint8_t *rows)
+{
+  uint16_t n;
+  if (!parse_number(p, len, &n) || n < 1 || n > CSV_TAIL_ROWS_MAX)
+  {
+    return false;
+  }
+  *rows = (uint8_t)n;
+  return true;
+}
+
+static bool parse_delim(uint8_t const *p, uint32_t len, uint8_t *delim)
+{
+  if (len == 1 && (p[0] == ',' || p[0] == ';'))
+  {
+    *delim = p[0];
+    return true;
+  }
+  if (key_is(p, len, "TAB"))
+  {
+    *delim = '\t';
+    return true;
+  }
+  return false;
+}
+
+static bool parse_decimals(uint8_t const *p, uint32_t len, uint8_t *decimals)
+{
+  if (len == 1 && p[0] >= '0' && p[0] <= '0' + FIXED_MAX_DECIMALS)
+  {
+    *decimals = p[0] - '0';
+    return true;
+  }
+  if (key_is(p, len, "AUTO"))
+  {
+    *decimals = PLAN_DECIMALS_AUTO;
+    return true;
+  }
+  if (key_is(p, len, "TEXT"))
+  {
+    *decimals = PLAN_DECIMALS_TEXT;
+    return true;
+  }
+  return false;
+}
+
+static bool parse_point(uint8_t const *p, uint32_t len, uint8_t *point)
+{
+  if (len == 1 && (p[0] == '.' || p[0] == ','))
+  {
+    *point = p[0];
+    return true;
+  }
+  return false;
+}
+
+static bool parse_flag(uint8_t const *p, uint32_t len, uint8_t *flag)
+{
+  if (len == 1 && (p[0] == '0' || p[0] == '1'))
+  {
+    *flag = p[0] - '0';
+    return true;
+  }
+  return false;
+}
+
+static bool is_space(uint8_t c)
+{
+  return c == ' ' || c == '\t' || c == '\r';
+}
+
+bool extract_plan_compile(uint8_t lun, uint8_t const *text, uint32_t len, extract_plan_t *plan)
+{
+  extract_plan_t compiled = *active_plans[lun];
+  uint32_t line_no = 0;
+  uint32_t pos = 0;
+
+  while (pos < len && text[pos] != '\0')
+  {
+    // Find the line and trim it
+    uint32_t start = pos;
+    while (pos < len && text[pos] != '\n' && text[pos] != '\0')
+    {
+      pos++;
+    }
+    uint32_t end = pos;
+    if (pos < len && text[pos] == '\n')
+    {
+      pos++;
+    }
+    line_no++;
+    while (start < end && is_space(text[start]))
+      start++;
+    while (end > start && is_space(text[end - 1]))
+      end--;
+    if (start == end || text[start] == '#')
+    {
+      continue;
+    }
+
+    uint8_t const *eq = memchr(&text[start], '=', end - start);
+    if (!eq)
+    {
+      printf("### PLAN: LINE %lu: MISSING '=' ###\r\n", (unsigned long)line_no);
+      return false;
+    }
+    uint32_t key_end = (uint32_t)(eq - text);
+    uint32_t value_start = key_end + 1;
+    while (key_end > start && is_space(text[key_end - 1]))
+      key_end--;
+    while (value_start < end && is_space(text[value_start]))
+      value_start++;
+
+    uint8_t const *key = &text[start];
+    uint32_t key_len = key_end - start;
+    uint8_t const *value = &text[value_start];
+    uint32_t value_len = end - value_start;
+
+    bool ok;
+    if (key_is(key, key_len, "ROW"))
+    {
+      ok = parse_row(value, value_len, &compiled.row);
+    }
+    else if (key_is(key, key_len, "COL"))
+    {
+      ok = parse_number(value, value_len, &compiled.col);
+    }
+    else if (key_is(key, key_len, "DELIM"))
+    {
+      ok = parse_delim(value, value_len, &compiled.delim);
+    }
+    else if (key_is(key, key_len, "DECIMALS"))
+    {
+      ok = parse_decimals(value, value_len, &compiled.decimals);
+    }
+    else if (key_is(key, key_len, "POINT"))
+    {
+      ok = parse_point(value, value_len, &compiled.point);
+    }
+    else if (key_is(key, key_len, "STATS"))
+    {
+      ok = parse_flag(value, value_len, &compiled.stats);
+    }
+    else if (key_is(key, key_len, "ROWS"))
+    {
+      ok = parse_rows(value, value_len, &compiled.rows);
+    }
+    else
+    {
+      printf("### PLAN: LINE %lu: UNKNOWN KEY IGNORED ###\r\n", (unsigned long)line_no);
+      continue;
+    }
+    if (!ok)
+    {
+      printf("### PLAN: LINE %lu: BAD VALUE ###\r\n", (unsigned long)line_no);
+      return false;
+    }
+  }
+
+  if (compiled.rows > 1 && compiled.row != PLAN_ROW_LAST)
+  {
+    printf("### PLAN: ROWS NEEDS ROW=LAST ###\r\n");
+    return false;
+  }
+
+  compiled.magic = PLAN_MAGIC;
+  compiled.version = PLAN_VERSION;
+  compiled.length = sizeof(extract_plan_t);
+  compiled.crc = plan_crc(&compiled);
+  *plan = compiled;
+  return true;
+}
+
+uint32_t extract_plan_format(extract_plan_t const *plan, char *text, uint32_t size)
+{
+  char buf[2];
+  char row_buf[6];
+  int n = snprintf(text, size,
+                   "# LIT extraction config. Edit and save to change the extracted field.\r\n"
+                   "# Rows and columns count from 0. DELIM is , ; or TAB.\r\n"
+                   "# DECIMALS is 0 to %u, AUTO (as in the file) or TEXT (not a number). POINT is . or ,\r\n"
+                   "# STATS=1 sends count, mean, min, max and standard deviation of the column from ROW on.\r\n"
+                   "# ROW=LAST takes the newest row. ROWS=2 to %u with it sends that many, tab separated.\r\n"
+                   "ROW=%s\r\n"
+                   "COL=%u\r\n"
+                   "DELIM=%s\r\n"
+                   "DECIMALS=%s\r\n"
+                   "POINT=%c\r\n"
+                   "STATS=%u\r\n"
+                   "ROWS=%u\r\n",
+                   FIXED_MAX_DECIMALS, CSV_TAIL_ROWS_MAX, row_name(plan->row, row_buf, sizeof(row_buf)), plan->col,
+                   delim_name(plan->delim), decimals_name(plan->decimals, buf), plan->point, plan->stats, plan->rows);
+  if (n < 0)
+  {
+    return 0;
+  }
+  return (uint32_t)n < size ? (uint32_t)n : size - 1;
+}
+
+//--------------------------------------------------------------------+
+// Flash
+//--------------------------------------------------------------------+
+
+bool extract_plan_store(uint8_t lun, extract_plan_t const *plan)
+{
+  extract_plan_t const *stored = PLAN_STORED(lun);
+  if (memcmp(stored, plan, sizeof(extract_plan_t)) == 0)
+  {
+    active_plans[lun] = stored;
+    return true; // nothing changed, save a flash erase
+  }
+
+  // The whole sector is erased, so the pages of the other LUNs are written back as they were
+  static uint8_t pages[MSC_LUNS][FLASH_PAGE_SIZE];
+  for (uint8_t l = 0; l < MSC_LUNS; l++)
+  {
+    memcpy(pages[l], PLAN_STORED(l), FLASH_PAGE_SIZE);
+    ram_plans[l] = l == lun ? *plan : *active_plans[l];
+    active_plans[l] = &ram_plans[l];
+  }
+  memset(pages[lun], 0xff, FLASH_PAGE_SIZE);
+  memcpy(pages[lun], plan, sizeof(extract_plan_t));
+
+  // The flash can't be read (or executed from) while it is written, so nothing may interrupt this
+  uint32_t status = save_and_disable_interrupts();
+  flash_range_erase(PLAN_FLASH_OFFSET, FLASH_SECTOR_SIZE);
+  flash_range_program(PLAN_FLASH_OFFSET, &pages[0][0], sizeof(pages));
+  restore_interrupts(status);
+
+  if (memcmp(stored, plan, sizeof(extract_plan_t)) != 0)
+  {
+    printf("### PLAN: FLASH WRITE FAILED ###\r\n");
+    return false; // the RAM copies stay active until the next reset
+  }
+  for (uint8_t l = 0; l < MSC_LUNS; l++)
+  {
+    active_plans[l] = load_plan(l);
+  }
+  char buf[6];
+  printf("### PLAN: STORED LUN=%u ROW=%s COL=%u DELIM=%s ###\r\n", lun, row_name(plan->row, buf, sizeof(buf)),
+         plan->col, delim_name(plan->delim));
+  return true;
+}
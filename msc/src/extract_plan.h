@@ -0,0 +1,67 @@
+#ifndef EXTRACT_PLAN_H_
+#define EXTRACT_PLAN_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Extraction plan
+// The settings of the CSV extractor, compiled from the text of CONFIG.TXT into a compact binary form.
+// The plan is stored in a reserved flash sector and used in place through the XIP address space,
+// so there is nothing to parse at boot and the extractor reads pre-resolved values.
+// Every LUN (msc_lun.h) has its own plan, in its own page of the sector.
+
+#define PLAN_MAGIC 0x4e4c504c // "LPLN"
+#define PLAN_VERSION 5
+
+// Used for LUN 0 when the flash sector holds no valid plan, see msc_lun.c for the others
+#define PLAN_DEFAULT_ROW 5
+#define PLAN_DEFAULT_COL 2
+#define PLAN_DEFAULT_DELIM ','
+#define PLAN_DEFAULT_DECIMALS PLAN_DECIMALS_AUTO
+#define PLAN_DEFAULT_POINT '.'
+#define PLAN_DEFAULT_ROWS 1
+
+// Special value of row
+#define PLAN_ROW_LAST 0xffff // the newest rows of the file, see csv_tail_t
+
+// Special values of decimals
+#define PLAN_DECIMALS_AUTO 0xfe // parse the field as a number and keep its own decimals
+#define PLAN_DECIMALS_TEXT 0xff // send the field as it is, without parsing it
+
+typedef struct
+{
+  uint32_t magic;
+  uint16_t version;
+  uint16_t length;  // sizeof(extract_plan_t) when stored
+  uint16_t row;     // row of the field to extract, 0 is the first line of the file, or PLAN_ROW_LAST
+  uint16_t col;     // column of the field to extract, 0 is the first column
+  uint8_t delim;    // field delimiter of the CSV files: ',', ';' or '\t'
+  uint8_t decimals; // decimals of the number sent, up to FIXED_MAX_DECIMALS, or PLAN_DECIMALS_AUTO or _TEXT
+  uint8_t point;    // decimal separator of the number sent, '.' or ','
+  uint8_t stats;    // 1: send the statistics of the column from the row on instead of the field, see column_stats.h
+  uint8_t rows;     // with PLAN_ROW_LAST, the number of newest rows sent, up to CSV_TAIL_ROWS_MAX
+  uint8_t spare[3]; // keeps the struct free of padding, which the CRC would cover
+  uint32_t crc;     // CRC32 of all of the above
+} extract_plan_t;
+
+// Check the plans stored in flash, and fall back to the defaults of the LUNs whose plan isn't valid
+void extract_plan_init(void);
+
+// Log the active plans. Kept out of extract_plan_init, which runs before USB is up.
+void extract_plan_log(void);
+
+// The active plan of a LUN
+extract_plan_t const *extract_plan(uint8_t lun);
+
+// Compile config text (KEY=VALUE lines, # comments) on top of the active plan of a LUN.
+// Returns false without changing *plan if the text has an error.
+bool extract_plan_compile(uint8_t lun, uint8_t const *text, uint32_t len, extract_plan_t *plan);
+
+// Write a plan as config text. Returns the length of the text.
+uint32_t extract_plan_format(extract_plan_t const *plan, char *text, uint32_t size);
+
+// Store the plan of a LUN in flash and make it the active plan. Interrupts are disabled while the flash is erased
+// and programmed, so call it from a task rather than a USB callback.
+bool extract_plan_store(uint8_t lun, extract_plan_t const *plan);
+
+#endif /* EXTRACT_PLAN_H_ */
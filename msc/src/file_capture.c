@@ -0,0 +1,711 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "disk_layout.h"
+#include "file_capture.h"
+#include "msc_lun.h"
+#include "hot_path.h"
+
+#define CAPTURE_ARENA_SIZE (32 * 1024) // sectors that can't be passed on yet
+#define CAPTURE_MAX_SECTORS (CAPTURE_ARENA_SIZE / DISK_BLOCK_SIZE)
+#define CAPTURE_MAX_DIRS 16 // directories whose entries are watched
+#define CAPTURE_EXTENSION "CSV" // only files with this extension are passed on for extraction
+#define CAPTURE_CONFIG_NAME "CONFIG.TXT" // and the extraction config
+
+#define FAT_ENTRIES (DISK_FAT_SECTORS * DISK_BLOCK_SIZE / 2)
+#define FAT_EOC 0xfff8 // end of cluster chain (0xfff8 - 0xffff)
+
+#define DIR_ENTRY_SIZE 32
+#define ATTR_VOLUME_ID 0x08
+#define ATTR_DIRECTORY 0x10
+#define ATTR_LONG_NAME 0x0f
+
+#define CHAIN_HASH_SEED 2166136261u // FNV-1a
+
+typedef enum
+{
+  SECTOR_FREE,
+  SECTOR_LOOSE,  // doesn't follow on from any stream yet
+  SECTOR_STREAM, // part of a stream, not passed on yet
+} sector_state_t;
+
+typedef struct
+{
+  uint32_t lba;
+  uint32_t index; // in its stream
+  uint8_t state;
+  uint8_t stream;
+} captured_sector_t;
+
+// A file being written, from the first sector of its first cluster on. Its sectors are in cluster order, and every
+// cluster but the newest is complete.
+typedef struct
+{
+  bool open;
+  bool guessed;           // sectors were passed on without the FAT, to make room in the arena
+  uint16_t first_cluster;
+  uint32_t newest_lba;
+  uint32_t sectors;       // so far
+  uint32_t passed;        // passed on to file_capture_data_cb, the others are in the arena
+  uint32_t passed_hash;   // of the clusters passed on, checked against the FAT chain before the file is committed
+  uint32_t last_write;    // the stream written longest ago makes way for a new one
+  fat_file_t file;        // the directory entry that points at the stream, once one is written
+  bool has_file;
+} stream_t;
+
+// Capture state of a LUN's volume
+typedef struct
+{
+  // Static arena: a slot per data sector that can't be passed on yet
+  uint8_t arena[CAPTURE_ARENA_SIZE] __attribute__((aligned(4)));
+  captured_sector_t sectors[CAPTURE_MAX_SECTORS]; // sector n is held at arena[n * DISK_BLOCK_SIZE]
+
+  stream_t streams[CAPTURE_STREAMS];
+  uint32_t writes; // data sectors written, to age the streams
+
+  // Copy of the first FAT, updated from the sectors the host reads and writes
+  uint16_t fat[FAT_ENTRIES];
+
+  // First clusters of the sub-directories, learned from directory entries
+  uint16_t dir_clusters[CAPTURE_MAX_DIRS];
+  uint32_t dir_count;
+} capture_t;
+
+static capture_t volumes[MSC_LUNS];
+static capture_t *vol = &volumes[0]; // the LUN being read or written, set by the API functions
+
+static uint8_t HOT_FUNC(lun_of)(void)
+{
+  return (uint8_t)(vol - volumes);
+}
+
+static uint8_t HOT_FUNC(stream_of)(stream_t const *s)
+{
+  return (uint8_t)(s - vol->streams);
+}
+
+//--------------------------------------------------------------------+
+// Arena
+//--------------------------------------------------------------------+
+
+static uint8_t *HOT_FUNC(sector_data)(captured_sector_t const *s)
+{
+  return &vol->arena[(s - vol->sectors) * DISK_BLOCK_SIZE];
+}
+
+static captured_sector_t *HOT_FUNC(find_sector)(uint32_t lba)
+{
+  for (uint32_t i = 0; i < CAPTURE_MAX_SECTORS; i++)
+  {
+    if (vol->sectors[i].state != SECTOR_FREE && vol->sectors[i].lba == lba)
+    {
+      return &vol->sectors[i];
+    }
+  }
+  return NULL;
+}
+
+static captured_sector_t *HOT_FUNC(stream_sector)(stream_t const *s, uint32_t index)
+{
+  for (uint32_t i = 0; i < CAPTURE_MAX_SECTORS; i++)
+  {
+    captured_sector_t *sector = &vol->sectors[i];
+    if (sector->state == SECTOR_STREAM && sector->stream == stream_of(s) && sector->index == index)
+    {
+      return sector;
+    }
+  }
+  return NULL;
+}
+
+static captured_sector_t *HOT_FUNC(free_sector)(void)
+{
+  for (uint32_t i = 0; i < CAPTURE_MAX_SECTORS; i++)
+  {
+    if (vol->sectors[i].state == SECTOR_FREE)
+    {
+      return &vol->sectors[i];
+    }
+  }
+  return NULL;
+}
+
+//--------------------------------------------------------------------+
+// FAT
+//--------------------------------------------------------------------+
+
+static bool HOT_FUNC(valid_cluster)(uint16_t cluster)
+{
+  return cluster >= 2 && cluster < FAT_EOC && cluster < FAT_ENTRIES;
+}
+
+static bool HOT_FUNC(is_dir_cluster)(uint16_t cluster)
+{
+  for (uint32_t i = 0; i < vol->dir_count; i++)
+  {
+    // Follow the chain of the directory, in case it grew past one cluster
+    uint16_t c = vol->dir_clusters[i];
+    for (int n = 0; n < 64 && valid_cluster(c); n++)
+    {
+      if (c == cluster)
+      {
+        return true;
+      }
+      c = vol->fat[c];
+    }
+  }
+  return false;
+}
+
+static void HOT_FUNC(add_dir_cluster)(uint16_t cluster)
+{
+  if (!valid_cluster(cluster))
+  {
+    return;
+  }
+  for (uint32_t i = 0; i < vol->dir_count; i++)
+  {
+    if (vol->dir_clusters[i] == cluster)
+    {
+      return;
+    }
+  }
+  if (vol->dir_count < CAPTURE_MAX_DIRS)
+  {
+    vol->dir_clusters[vol->dir_count++] = cluster;
+  }
+}
+
+//--------------------------------------------------------------------+
+// Directory entries
+//--------------------------------------------------------------------+
+
+static uint16_t HOT_FUNC(get_u16)(uint8_t const *p)
+{
+  return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t HOT_FUNC(get_u32)(uint8_t const *p)
+{
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+// Decode a short directory entry. Returns false for free, deleted, long name, label and dot entries.
+static bool HOT_FUNC(decode_entry)(uint8_t const *e, fat_file_t *file)
+{
+  uint8_t attr = e[11];
+  if (e[0] == 0x00 || e[0] == 0xe5 || e[0] == '.' || (attr & ATTR_LONG_NAME) == ATTR_LONG_NAME || (attr & ATTR_VOLUME_ID))
+  {
+    return false;
+  }
+
+  int n = 0;
+  for (int i = 0; i < 8 && e[i] != ' '; i++)
+  {
+    file->name[n++] = (char)((i == 0 && e[i] == 0x05) ? 0xe5 : e[i]); // 0x05 stands for a leading 0xe5
+  }
+  if (e[8] != ' ')
+  {
+    file->name[n++] = '.';
+    for (int i = 8; i < 11 && e[i] != ' '; i++)
+    {
+      file->name[n++] = (char)e[i];
+    }
+  }
+  file->name[n] = '\0';
+
+  file->attr = attr;
+  file->first_cluster = get_u16(&e[26]); // FAT16 has no high word
+  file->size = get_u32(&e[28]);
+  return true;
+}
+
+//--------------------------------------------------------------------+
+// Streams
+//--------------------------------------------------------------------+
+
+static uint16_t HOT_FUNC(cluster_of)(uint32_t lba)
+{
+  return (uint16_t)((lba - DISK_DATA_LBA) / DISK_SECTORS_PER_CLUSTER + 2);
+}
+
+static bool HOT_FUNC(is_cluster_start)(uint32_t lba)
+{
+  return (lba - DISK_DATA_LBA) % DISK_SECTORS_PER_CLUSTER == 0;
+}
+
+static uint32_t HOT_FUNC(hash_cluster)(uint32_t hash, uint16_t cluster)
+{
+  return (hash ^ cluster) * 16777619u;
+}
+
+// The sector that follows the newest one of a stream. At the end of a cluster, that is the first sector of the next
+// cluster of the chain if the FAT already has it, or else of the next cluster on the volume, where the host puts a
+// file written in one go. A guess isn't passed on before the FAT confirms it.
+static uint32_t HOT_FUNC(next_lba)(stream_t const *s)
+{
+  if (!is_cluster_start(s->newest_lba + 1))
+  {
+    return s->newest_lba + 1;
+  }
+  uint16_t cluster = cluster_of(s->newest_lba);
+  uint16_t next = vol->fat[cluster];
+  return DISK_CLUSTER_LBA(valid_cluster(next) ? next : cluster + 1);
+}
+
+static stream_t *HOT_FUNC(stream_expecting)(uint32_t lba)
+{
+  for (uint32_t i = 0; i < CAPTURE_STREAMS; i++)
+  {
+    stream_t *s = &vol->streams[i];
+    if (s->open && next_lba(s) == lba)
+    {
+      return s;
+    }
+  }
+  return NULL;
+}
+
+static stream_t *HOT_FUNC(stream_starting)(uint16_t cluster)
+{
+  for (uint32_t i = 0; i < CAPTURE_STREAMS; i++)
+  {
+    stream_t *s = &vol->streams[i];
+    if (s->open && s->first_cluster == cluster)
+    {
+      return s;
+    }
+  }
+  return NULL;
+}
+
+static void HOT_FUNC(free_stream_sectors)(stream_t const *s, uint32_t below)
+{
+  for (uint32_t i = 0; i < CAPTURE_MAX_SECTORS; i++)
+  {
+    captured_sector_t *sector = &vol->sectors[i];
+    if (sector->state == SECTOR_STREAM && sector->stream == stream_of(s) && sector->index < below)
+    {
+      sector->state = SECTOR_FREE;
+    }
+  }
+}
+
+static void HOT_FUNC(close_stream)(stream_t *s)
+{
+  if (s->open)
+  {
+    free_stream_sectors(s, UINT32_MAX);
+    s->open = false;
+  }
+}
+
+static void HOT_FUNC(push_sector)(stream_t *s, captured_sector_t *sector)
+{
+  sector->state = SECTOR_STREAM;
+  sector->stream = stream_of(s);
+  sector->index = s->sectors++;
+  s->newest_lba = sector->lba;
+}
+
+// Pass the oldest sector of a stream that is still in the arena on, len bytes of it
+static void HOT_FUNC(pass_on)(stream_t *s, uint32_t len)
+{
+  captured_sector_t *sector = stream_sector(s, s->passed);
+  if (s->passed % DISK_SECTORS_PER_CLUSTER == 0)
+  {
+    s->passed_hash = hash_cluster(s->passed_hash, cluster_of(sector->lba));
+  }
+  file_capture_data_cb(lun_of(), stream_of(s), sector_data(sector), len);
+  sector->state = SECTOR_FREE;
+  s->passed++;
+}
+
+// Pass on the clusters of a stream that the FAT shows to be followed by the next cluster of the stream. The last
+// cluster of a file stays in the arena until the directory entry tells where in it the file ends.
+static void HOT_FUNC(pass_on_linked)(stream_t *s)
+{
+  while (true)
+  {
+    uint32_t next_index = (s->passed / DISK_SECTORS_PER_CLUSTER + 1) * DISK_SECTORS_PER_CLUSTER;
+    if (next_index >= s->sectors)
+    {
+      return; // the stream doesn't go on past this cluster yet
+    }
+    uint16_t cluster = cluster_of(stream_sector(s, s->passed)->lba);
+    if (vol->fat[cluster] != cluster_of(stream_sector(s, next_index)->lba))
+    {
+      return;
+    }
+    while (s->passed < next_index)
+    {
+      pass_on(s, DISK_BLOCK_SIZE);
+    }
+  }
+}
+
+// A slot for a written sector. When the arena is full, the sectors that follow on from nothing are dropped, and if
+// that isn't enough, the stream that holds the most passes its oldest sector on without waiting for the FAT.
+static captured_sector_t *HOT_FUNC(alloc_sector)(uint32_t lba, uint8_t const *buffer)
+{
+  captured_sector_t *sector = free_sector();
+  if (!sector)
+  {
+    for (uint32_t i = 0; i < CAPTURE_MAX_SECTORS; i++)
+    {
+      if (vol->sectors[i].state == SECTOR_LOOSE)
+      {
+        vol->sectors[i].state = SECTOR_FREE;
+        sector = &vol->sectors[i];
+      }
+    }
+    if (sector)
+    {
+      printf("### CAPTURE: ARENA FULL ###\r\n");
+    }
+  }
+  if (!sector)
+  {
+    stream_t *s = &vol->streams[0];
+    for (uint32_t i = 1; i < CAPTURE_STREAMS; i++)
+    {
+      stream_t *other = &vol->streams[i];
+      if (other->open && (!s->open || other->sectors - other->passed > s->sectors - s->passed))
+      {
+        s = other;
+      }
+    }
+    if (!s->guessed)
+    {
+      printf("### CAPTURE: STREAM AT CLUSTER %u PASSED ON WITHOUT THE FAT ###\r\n", s->first_cluster);
+      s->guessed = true;
+    }
+    sector = stream_sector(s, s->passed); // the newest sector is never the only one left, there are more slots
+    pass_on(s, DISK_BLOCK_SIZE);
+  }
+  sector->lba = lba;
+  sector->state = SECTOR_LOOSE;
+  memcpy(sector_data(sector), buffer, DISK_BLOCK_SIZE);
+  return sector;
+}
+
+// Whether the FAT holds the chain of the clusters of the first sectors of a stream, ending right after them
+static bool HOT_FUNC(chain_matches)(stream_t const *s, uint32_t sectors)
+{
+  uint32_t clusters = (sectors + DISK_SECTORS_PER_CLUSTER - 1) / DISK_SECTORS_PER_CLUSTER;
+  uint32_t hash = CHAIN_HASH_SEED;
+  uint16_t cluster = s->first_cluster;
+  for (uint32_t n = 0; n < clusters; n++)
+  {
+    if (!valid_cluster(cluster))
+    {
+      return false;
+    }
+    uint32_t index = n * DISK_SECTORS_PER_CLUSTER;
+    if (index < s->passed)
+    {
+      hash = hash_cluster(hash, cluster);
+    }
+    else if (stream_sector(s, index)->lba != DISK_CLUSTER_LBA(cluster))
+    {
+      return false;
+    }
+    cluster = vol->fat[cluster];
+  }
+  return hash == s->passed_hash && cluster >= FAT_EOC;
+}
+
+// Whether the FAT chain from cluster on is that many clusters long
+static bool HOT_FUNC(chain_has_length)(uint16_t cluster, uint32_t clusters)
+{
+  for (uint32_t n = 0; n < clusters; n++)
+  {
+    if (!valid_cluster(cluster))
+    {
+      return false;
+    }
+    cluster = vol->fat[cluster];
+  }
+  return cluster >= FAT_EOC;
+}
+
+static bool HOT_FUNC(is_watched)(fat_file_t const *file)
+{
+  char const *ext = strrchr(file->name, '.');
+  return (ext && strcmp(ext + 1, CAPTURE_EXTENSION) == 0) || strcmp(file->name, CAPTURE_CONFIG_NAME) == 0;
+}
+
+static void HOT_FUNC(start_stream)(stream_t *s, uint16_t cluster)
+{
+  s->open = true;
+  s->guessed = false;
+  s->first_cluster = cluster;
+  s->sectors = 0;
+  s->passed = 0;
+  s->passed_hash = CHAIN_HASH_SEED;
+  s->last_write = vol->writes;
+  s->has_file = false;
+  file_capture_start_cb(lun_of(), stream_of(s));
+}
+
+// Once the size in the directory entry is covered by the sectors of a stream, and the FAT holds the chain of their
+// clusters, hand the rest of the file on exactly once. Sectors after the file's last cluster are the start of the
+// next file, which the host wrote right behind it before the FAT: they go on as a stream of their own.
+// A stream passed on without the FAT may have gone past the end of the file, into the next one. The file is lost
+// then, and the stream goes on from the next file, unless that was passed on as well.
+static void HOT_FUNC(try_commit)(stream_t *s)
+{
+  uint32_t needed = (s->file.size + DISK_BLOCK_SIZE - 1) / DISK_BLOCK_SIZE;
+  uint32_t clusters = (needed + DISK_SECTORS_PER_CLUSTER - 1) / DISK_SECTORS_PER_CLUSTER;
+  uint32_t next_index = clusters * DISK_SECTORS_PER_CLUSTER;
+  if (!s->open || !s->has_file || s->sectors < needed)
+  {
+    return; // the size or the data isn't final yet
+  }
+  fat_file_t const *file = &s->file;
+  if (s->passed >= needed)
+  {
+    if (!chain_has_length(s->first_cluster, clusters))
+    {
+      return; // the size or the FAT isn't final yet
+    }
+    printf(is_watched(file) ? "### CAPTURE: %s LOST ###\r\n" : "### CAPTURE: %s SKIPPED ###\r\n", file->name);
+    if (s->passed > next_index)
+    {
+      close_stream(s);
+      return;
+    }
+  }
+  else if (!chain_matches(s, needed))
+  {
+    return; // the FAT or the data isn't final yet
+  }
+  else if (is_watched(file))
+  {
+    printf("### CAPTURE: %s SIZE=%lu ###\r\n", file->name, (unsigned long)file->size);
+    while (s->passed < needed - 1)
+    {
+      pass_on(s, DISK_BLOCK_SIZE);
+    }
+    uint32_t len = file->size - (needed - 1) * DISK_BLOCK_SIZE;
+    file_capture_done_cb(lun_of(), stream_of(s), file, sector_data(stream_sector(s, needed - 1)), len);
+  }
+  else
+  {
+    printf("### CAPTURE: %s SKIPPED ###\r\n", file->name);
+  }
+
+  uint32_t sectors = s->sectors;
+  free_stream_sectors(s, next_index);
+  if (next_index >= sectors)
+  {
+    s->open = false;
+    return;
+  }
+  start_stream(s, cluster_of(stream_sector(s, next_index)->lba));
+  for (uint32_t i = next_index; i < sectors; i++)
+  {
+    push_sector(s, stream_sector(s, i));
+  }
+  pass_on_linked(s);
+}
+
+// Add the sectors that were written ahead of the one they follow, pass on what the FAT confirms, and commit the
+// file if its entry is already final
+static void HOT_FUNC(follow_stream)(stream_t *s)
+{
+  while (true)
+  {
+    captured_sector_t *sector = find_sector(next_lba(s));
+    if (sector && sector->state == SECTOR_LOOSE)
+    {
+      push_sector(s, sector);
+      continue;
+    }
+    stream_t *ahead = sector && sector->index == 0 ? &vol->streams[sector->stream] : NULL;
+    if (ahead && ahead != s && ahead->passed == 0 && !ahead->has_file)
+    {
+      // A cluster written ahead was taken for the start of another file. Nothing of it has been passed on yet,
+      // so it is taken back.
+      uint32_t sectors = ahead->sectors;
+      for (uint32_t i = 0; i < sectors; i++)
+      {
+        push_sector(s, stream_sector(ahead, i));
+      }
+      ahead->open = false;
+      continue;
+    }
+    break;
+  }
+  pass_on_linked(s);
+  try_commit(s);
+}
+
+// The first sector of a cluster that doesn't follow on from another stream starts a new one
+static void HOT_FUNC(new_stream)(captured_sector_t *sector)
+{
+  uint16_t cluster = cluster_of(sector->lba);
+  stream_t *s = stream_starting(cluster); // the host writes the file again from the start
+  for (uint32_t i = 0; i < CAPTURE_STREAMS && !s; i++)
+  {
+    if (!vol->streams[i].open)
+    {
+      s = &vol->streams[i];
+    }
+  }
+  if (!s)
+  {
+    s = &vol->streams[0];
+    for (uint32_t i = 1; i < CAPTURE_STREAMS; i++)
+    {
+      if (vol->streams[i].last_write - s->last_write > (uint32_t)INT32_MAX)
+      {
+        s = &vol->streams[i]; // written longer ago
+      }
+    }
+    printf("### CAPTURE: STREAM AT CLUSTER %u DROPPED ###\r\n", s->first_cluster);
+  }
+  close_stream(s);
+  start_stream(s, cluster);
+  push_sector(s, sector);
+  follow_stream(s);
+}
+
+static void HOT_FUNC(capture_sector)(uint32_t lba, uint8_t const *buffer)
+{
+  vol->writes++;
+  captured_sector_t *sector = find_sector(lba);
+  if (sector)
+  {
+    // Written again before it was passed on, e.g. the last sector of a file with more rows
+    memcpy(sector_data(sector), buffer, DISK_BLOCK_SIZE);
+    if (sector->state == SECTOR_STREAM)
+    {
+      vol->streams[sector->stream].last_write = vol->writes;
+    }
+    return;
+  }
+
+  sector = alloc_sector(lba, buffer);
+  stream_t *s = stream_expecting(lba);
+  if (s)
+  {
+    s->last_write = vol->writes;
+    push_sector(s, sector);
+    follow_stream(s);
+  }
+  else if (is_cluster_start(lba))
+  {
+    new_stream(sector);
+  }
+  // else a loose sector, until a stream reaches it
+}
+
+// Scan a directory sector. On a write, a file entry that points at a stream is committed once it is closed.
+static void HOT_FUNC(scan_dir_sector)(uint8_t const *buffer, bool written)
+{
+  for (uint32_t i = 0; i < DISK_BLOCK_SIZE; i += DIR_ENTRY_SIZE)
+  {
+    if (buffer[i] == 0x00)
+    {
+      break; // no more entries in this directory
+    }
+
+    fat_file_t file;
+    if (!decode_entry(&buffer[i], &file))
+    {
+      continue;
+    }
+
+    stream_t *s;
+    if (file.attr & ATTR_DIRECTORY)
+    {
+      add_dir_cluster(file.first_cluster);
+    }
+    else if (written && file.size > 0 && (s = stream_starting(file.first_cluster)) != NULL)
+    {
+      // If the size, the FAT or the data isn't final yet, this is checked again as they are written
+      s->file = file;
+      s->has_file = true;
+      try_commit(s);
+    }
+  }
+}
+
+static void HOT_FUNC(update_fat)(uint32_t lba, uint8_t const *sector)
+{
+  uint16_t *entries = &vol->fat[(lba - DISK_FAT_LBA) * (DISK_BLOCK_SIZE / 2)];
+  for (uint32_t i = 0; i < DISK_BLOCK_SIZE / 2; i++)
+  {
+    entries[i] = get_u16(&sector[2 * i]);
+  }
+}
+
+static bool HOT_FUNC(is_fat_sector)(uint32_t lba)
+{
+  return lba >= DISK_FAT_LBA && lba < DISK_FAT_LBA + DISK_FAT_SECTORS;
+}
+
+static bool HOT_FUNC(is_dir_sector)(uint32_t lba)
+{
+  if (lba >= DISK_ROOT_DIR_LBA && lba < DISK_DATA_LBA)
+  {
+    return true;
+  }
+  if (lba >= DISK_DATA_LBA)
+  {
+    return is_dir_cluster((uint16_t)((lba - DISK_DATA_LBA) / DISK_SECTORS_PER_CLUSTER + 2));
+  }
+  return false;
+}
+
+//--------------------------------------------------------------------+
+// API
+//--------------------------------------------------------------------+
+
+void HOT_FUNC(file_capture_read)(uint8_t lun, uint32_t lba, uint8_t const *buffer, uint32_t bufsize)
+{
+  vol = &volumes[lun];
+  for (uint32_t off = 0; off + DISK_BLOCK_SIZE <= bufsize; off += DISK_BLOCK_SIZE, lba++)
+  {
+    if (is_fat_sector(lba))
+    {
+      // Chains the host never rewrites, such as the one of CONFIG.TXT, are only ever read
+      update_fat(lba, buffer + off);
+    }
+    else if (is_dir_sector(lba))
+    {
+      scan_dir_sector(buffer + off, false);
+    }
+  }
+}
+
+void HOT_FUNC(file_capture_write)(uint8_t lun, uint32_t lba, uint8_t const *buffer, uint32_t bufsize)
+{
+  vol = &volumes[lun];
+  for (uint32_t off = 0; off + DISK_BLOCK_SIZE <= bufsize; off += DISK_BLOCK_SIZE, lba++)
+  {
+    uint8_t const *sector = buffer + off;
+    if (is_fat_sector(lba))
+    {
+      // First FAT: keep the copy up to date. The second FAT is a duplicate and is ignored.
+      update_fat(lba, sector);
+      for (uint32_t i = 0; i < CAPTURE_STREAMS; i++)
+      {
+        if (vol->streams[i].open)
+        {
+          pass_on_linked(&vol->streams[i]);
+          try_commit(&vol->streams[i]);
+        }
+      }
+    }
+    else if (is_dir_sector(lba))
+    {
+      scan_dir_sector(sector, true);
+    }
+    else if (lba >= DISK_DATA_LBA)
+    {
+      capture_sector(lba, sector);
+    }
+  }
+}
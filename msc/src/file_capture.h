@@ -0,0 +1,51 @@
+#ifndef FILE_CAPTURE_H_
+#define FILE_CAPTURE_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Whole-file capture
+// The host writes a file as a series of unrelated sector writes: the data sectors, then the FAT, then the
+// directory entry with the final size. Each file is passed on as a stream, a sector at a time in the order of its
+// cluster chain, as the host writes it, so a file of any length is extracted in one pass without being kept in RAM.
+// A stream starts with the first sector of a cluster that doesn't follow on from another stream. Sectors written
+// ahead of the one they follow are kept in a static arena until the stream reaches them, and the sectors of a
+// cluster are only passed on once the FAT links it to the next cluster of the stream, as the host may have written
+// the next file right behind this one. The last cluster stays in the arena until the directory entry tells where in
+// it the file ends. Once an entry's size is covered by the sectors of a stream, and the FAT holds the chain of their
+// clusters, the file is closed: for a *.CSV file or CONFIG.TXT, file_capture_done_cb is invoked exactly once. Other
+// files are dropped. When the arena is full, a stream is passed on without waiting for the FAT, and the file is
+// only extracted if the chain turns out to be the one that was guessed. If the guess ran on past the end of the file,
+// into the next one, the file is logged as lost and no callback is invoked for it.
+// A file written into fragmented free space is only followed if the host writes its FAT chain before its data.
+// Every LUN (msc_lun.h) has its own arena, streams and copy of the FAT.
+
+#define CAPTURE_STREAMS 4 // files written at the same time, per LUN
+
+// A file as described by its directory entry
+typedef struct
+{
+  char name[13]; // 8.3 name with the padding removed, e.g. "DATA0001.CSV"
+  uint8_t attr;
+  uint16_t first_cluster;
+  uint32_t size;
+} fat_file_t;
+
+// Feed every sector the host reads, so that the FAT and the directory clusters are known before the host writes
+void file_capture_read(uint8_t lun, uint32_t lba, uint8_t const *buffer, uint32_t bufsize);
+
+// Feed every sector the host writes
+void file_capture_write(uint8_t lun, uint32_t lba, uint8_t const *buffer, uint32_t bufsize);
+
+// Invoked when the host starts writing a file. stream, below CAPTURE_STREAMS, identifies the file in the calls that
+// follow. A stream that is dropped, or whose file isn't extracted, is simply started again for another file.
+void file_capture_start_cb(uint8_t lun, uint8_t stream);
+
+// Invoked with the data of the file, a whole sector at a time. Its name isn't known yet.
+void file_capture_data_cb(uint8_t lun, uint8_t stream, uint8_t const *data, uint32_t len);
+
+// Invoked when a CSV file or CONFIG.TXT has been closed, with the rest of its data: the last sector, cut to the
+// size of the file. That is the whole file when it fits in a sector. data is only valid until the callback returns.
+void file_capture_done_cb(uint8_t lun, uint8_t stream, fat_file_t const *file, uint8_t const *data, uint32_t len);
+
+#endif /* FILE_CAPTURE_H_ */
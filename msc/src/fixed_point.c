@@ -0,0 +1,194 @@
+#include "fixed_point.h"
+
+static uint32_t const powers_of_10[FIXED_MAX_DECIMALS + 1] = {
+    1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000,
+};
+
+static bool is_digit(uint8_t c)
+{
+  return c >= '0' && c <= '9';
+}
+
+bool fixed_parse(uint8_t const *text, uint32_t len, fixed_t *value)
+{
+  uint8_t const *p = text;
+  uint8_t const *end = text + len;
+  while (p < end && *p == ' ')
+    p++;
+  while (end > p && end[-1] == ' ')
+    end--;
+
+  bool negative = false;
+  if (p < end && (*p == '-' || *p == '+'))
+  {
+    negative = (*p++ == '-');
+  }
+
+  // Significant digits go into the mantissa. The ones that don't fit only move the point, and the first of them
+  // rounds the mantissa.
+  uint32_t mantissa = 0;
+  int32_t exp10 = 0;
+  uint8_t round_digit = 0;
+  bool digits = false;
+  bool point = false;
+  bool full = false;
+  for (; p < end; p++)
+  {
+    if (is_digit(*p))
+    {
+      digits = true;
+      if (!full && mantissa <= (FIXED_MAX_MANTISSA - 9) / 10)
+      {
+        mantissa = mantissa * 10 + (*p - '0');
+        exp10 -= point;
+      }
+      else
+      {
+        if (!full)
+        {
+          round_digit = *p - '0';
+          full = true;
+        }
+        exp10 += !point;
+      }
+    }
+    else if ((*p == '.' || *p == ',') && !point)
+    {
+      point = true;
+    }
+    else
+    {
+      break;
+    }
+  }
+  if (!digits)
+  {
+    return false;
+  }
+
+  if (p < end && (*p == 'e' || *p == 'E'))
+  {
+    p++;
+    bool exp_negative = false;
+    if (p < end && (*p == '-' || *p == '+'))
+    {
+      exp_negative = (*p++ == '-');
+    }
+    if (p == end || !is_digit(*p))
+    {
+      return false;
+    }
+    int32_t e = 0;
+    for (; p < end && is_digit(*p); p++)
+    {
+      if (e < 100)
+      {
+        e = e * 10 + (*p - '0');
+      }
+    }
+    exp10 += exp_negative ? -e : e;
+  }
+  if (p != end)
+  {
+    return false; // not a number, or a unit after it
+  }
+
+  if (round_digit >= 5 && ++mantissa > FIXED_MAX_MANTISSA)
+  {
+    mantissa /= 10;
+    exp10++;
+  }
+  for (; exp10 > 0; exp10--)
+  {
+    if (mantissa > FIXED_MAX_MANTISSA / 10)
+    {
+      return false;
+    }
+    mantissa *= 10;
+  }
+
+  // A value smaller than 10^-FIXED_MAX_DECIMALS has nothing left to show
+  fixed_t parsed = {.mantissa = negative ? -(int32_t)mantissa : (int32_t)mantissa, .decimals = 0};
+  if (-exp10 > FIXED_MAX_DECIMALS)
+  {
+    parsed.decimals = FIXED_MAX_DECIMALS;
+    while (-exp10 > FIXED_MAX_DECIMALS + 1)
+    {
+      parsed.mantissa /= 10;
+      exp10++;
+    }
+    int32_t r = parsed.mantissa % 10;
+    parsed.mantissa = parsed.mantissa / 10 + (r >= 5) - (r <= -5);
+  }
+  else
+  {
+    parsed.decimals = (uint8_t)-exp10;
+  }
+  *value = parsed;
+  return true;
+}
+
+bool fixed_rescale(fixed_t *value, uint8_t decimals)
+{
+  if (decimals > FIXED_MAX_DECIMALS)
+  {
+    return false;
+  }
+  if (decimals < value->decimals)
+  {
+    uint32_t div = powers_of_10[value->decimals - decimals];
+    uint32_t magnitude = (uint32_t)(value->mantissa < 0 ? -value->mantissa : value->mantissa);
+    magnitude = (magnitude + div / 2) / div;
+    value->mantissa = value->mantissa < 0 ? -(int32_t)magnitude : (int32_t)magnitude;
+  }
+  else if (decimals > value->decimals)
+  {
+    uint32_t mul = powers_of_10[decimals - value->decimals];
+    uint32_t magnitude = (uint32_t)(value->mantissa < 0 ? -value->mantissa : value->mantissa);
+    if (magnitude > FIXED_MAX_MANTISSA / mul)
+    {
+      return false;
+    }
+    value->mantissa *= (int32_t)mul;
+  }
+  value->decimals = decimals;
+  return true;
+}
+
+uint32_t fixed_format(fixed_t const *value, char point, char *text, uint32_t size)
+{
+  // Digits are written backwards from the end of a scratch buffer: the decimals, the point, the integer part
+  char digits[FIXED_MAX_DECIMALS + 12];
+  char *p = digits + sizeof(digits);
+  uint32_t magnitude = (uint32_t)(value->mantissa < 0 ? -value->mantissa : value->mantissa);
+  for (uint8_t i = 0; i < value->decimals; i++)
+  {
+    *--p = (char)('0' + magnitude % 10);
+    magnitude /= 10;
+  }
+  if (value->decimals > 0)
+  {
+    *--p = point;
+  }
+  do
+  {
+    *--p = (char)('0' + magnitude % 10);
+    magnitude /= 10;
+  } while (magnitude > 0);
+  if (value->mantissa < 0)
+  {
+    *--p = '-';
+  }
+
+  uint32_t len = (uint32_t)(digits + sizeof(digits) - p);
+  if (len >= size)
+  {
+    return 0;
+  }
+  for (uint32_t i = 0; i < len; i++)
+  {
+    text[i] = p[i];
+  }
+  text[len] = '\0';
+  return len;
+}
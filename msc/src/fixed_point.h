@@ -0,0 +1,35 @@
+#ifndef FIXED_POINT_H_
+#define FIXED_POINT_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Fixed-point readings
+// An extracted field is parsed into a scaled integer and written back out in one canonical form, so the PC always
+// gets the same text for the same value. Only 32 bit integer arithmetic is used: no strtod, no soft-float.
+// Like csv_extract.c this has no dependency on the pico sdk.
+
+#define FIXED_MAX_MANTISSA 999999999 // 9 significant digits
+#define FIXED_MAX_DECIMALS 9
+
+// value = mantissa / 10^decimals
+typedef struct
+{
+  int32_t mantissa;
+  uint8_t decimals;
+} fixed_t;
+
+// Parse a number: optional sign, digits with a '.' or ',' decimal separator, optional exponent (e.g. -1,25E-3).
+// Spaces around the number are allowed, anything else isn't. Digits past the 9th significant one are rounded off.
+// Returns false if the text isn't a number or its value doesn't fit in 9 digits.
+bool fixed_parse(uint8_t const *text, uint32_t len, fixed_t *value);
+
+// Round (half away from zero) or extend a value to the given number of decimals.
+// Returns false if the result doesn't fit in 9 digits.
+bool fixed_rescale(fixed_t *value, uint8_t decimals);
+
+// Write a value as text, e.g. "-0.00125": a '-' only for negative values, no leading zeros, and exactly
+// value->decimals digits after the point. Returns the length of the text, or 0 if it doesn't fit in size.
+uint32_t fixed_format(fixed_t const *value, char point, char *text, uint32_t size);
+
+#endif /* FIXED_POINT_H_ */
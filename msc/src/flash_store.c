@@ -0,0 +1,354 @@
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "bsp/board_api.h"
+#include "pico/stdlib.h"
+#include "hardware/flash.h"
+#include "hardware/sync.h"
+#include "disk_layout.h"
+#include "flash_store.h"
+#include "record_dedup.h"
+#include "sched.h"
+#include "hot_path.h"
+
+#if FLASH_STORE
+
+// The blocks end where the plan sector (extract_plan.c) begins
+#define STORE_FLASH_OFFSET (PICO_FLASH_SIZE_BYTES - FLASH_SECTOR_SIZE - FLASH_STORE_SIZE)
+#define STORE_BLOCK(b) ((uint8_t const *)(XIP_BASE + STORE_FLASH_OFFSET + (b) * FLASH_STORE_BLOCK_SIZE))
+
+#define STORE_MAGIC 0x5254534c // "LSTR"
+
+// A sector is stored under a tag made of its LUN and LBA
+#define TAG(lun, lba) ((uint32_t)(lun) << 28 | (lba))
+#define TAG_EMPTY 0xffffffff
+
+// Locations of the sectors: the slots of the flash blocks, then the slots of the RAM buffer
+#define FLASH_SLOTS (FLASH_STORE_BLOCKS * FLASH_STORE_SLOTS)
+#define LOCATIONS (FLASH_SLOTS + FLASH_STORE_SLOTS)
+#define MAP_SIZE (2 * LOCATIONS) // at most half full
+
+static_assert(FLASH_STORE_SIZE % FLASH_STORE_BLOCK_SIZE == 0 && FLASH_STORE_BLOCK_SIZE == FLASH_SECTOR_SIZE,
+              "the store is made of whole flash sectors");
+static_assert((FLASH_STORE_SLOTS + 1) * DISK_BLOCK_SIZE == FLASH_STORE_BLOCK_SIZE, "a header and the slots");
+static_assert(FLASH_STORE_BLOCKS >= 3 && LOCATIONS < UINT16_MAX, "locations are kept in 16 bits");
+
+typedef struct
+{
+  uint32_t magic;
+  uint32_t seq;                       // the block programmed last has the highest
+  uint32_t tags[FLASH_STORE_SLOTS];   // tag of each slot, TAG_EMPTY if unused
+  uint32_t crc;                       // CRC32 of all of the above
+} block_header_t;
+
+static uint32_t slot_tags[LOCATIONS];            // tag of the sector in each location
+static uint16_t map[MAP_SIZE];                   // open addressing table from tag to location + 1, 0 if unused
+static uint8_t block_live[FLASH_STORE_BLOCKS];   // slots of each block that hold the current copy of a sector
+static uint32_t block_seq[FLASH_STORE_BLOCKS];
+static uint8_t buffer[FLASH_STORE_SLOTS][DISK_BLOCK_SIZE];
+static uint32_t buffered = 0;                    // slots of the buffer in use
+static bool dirty = false;                       // the buffer holds sectors that are only in RAM
+static uint32_t live = 0;                        // different sectors stored, in flash or in the buffer
+static uint32_t next_seq = 1;
+static uint32_t head = 0;                        // where the search for a free block starts
+static int last_victim = -1;
+static uint32_t last_write_ms = 0;
+static bool sync_requested = false;
+static bool enabled = false;
+static int store_task_id = -1;
+
+static uint8_t const *HOT_FUNC(slot_data)(uint32_t loc)
+{
+  if (loc >= FLASH_SLOTS)
+  {
+    return buffer[loc - FLASH_SLOTS];
+  }
+  return STORE_BLOCK(loc / FLASH_STORE_SLOTS) + (1 + loc % FLASH_STORE_SLOTS) * DISK_BLOCK_SIZE;
+}
+
+// Index of a tag in the map, or of the free entry where it goes
+static uint32_t HOT_FUNC(map_find)(uint32_t tag)
+{
+  uint32_t i = (tag * 2654435761u) % MAP_SIZE;
+  while (map[i] != 0 && slot_tags[map[i] - 1] != tag)
+  {
+    i = (i + 1) % MAP_SIZE;
+  }
+  return i;
+}
+
+// Point the map entry i at the sector's new location. The copy it pointed at, if any, is no longer live.
+static void HOT_FUNC(set_location)(uint32_t i, uint32_t tag, uint32_t loc)
+{
+  if (map[i] == 0)
+  {
+    live++;
+  }
+  else if (map[i] - 1u < FLASH_SLOTS)
+  {
+    block_live[(map[i] - 1u) / FLASH_STORE_SLOTS]--;
+  }
+  slot_tags[loc] = tag;
+  map[i] = (uint16_t)(loc + 1);
+  if (loc < FLASH_SLOTS)
+  {
+    block_live[loc / FLASH_STORE_SLOTS]++;
+  }
+}
+
+static uint32_t header_crc(block_header_t const *header)
+{
+  return dedup_crc32(0, (uint8_t const *)header, offsetof(block_header_t, crc));
+}
+
+static uint32_t free_blocks(void)
+{
+  uint32_t n = 0;
+  for (uint32_t b = 0; b < FLASH_STORE_BLOCKS; b++)
+  {
+    n += block_live[b] == 0;
+  }
+  return n;
+}
+
+// A block with no live slot, from head on, or -1. The block reclaimed last is only used if no other is free, so its
+// sectors stay in flash while their copies wait in the buffer.
+static int find_free_block(void)
+{
+  int found = -1;
+  for (uint32_t n = 0; n < FLASH_STORE_BLOCKS; n++)
+  {
+    uint32_t b = (head + n) % FLASH_STORE_BLOCKS;
+    if (block_live[b] == 0)
+    {
+      if ((int)b != last_victim)
+      {
+        return (int)b;
+      }
+      found = (int)b;
+    }
+  }
+  return found;
+}
+
+// Move the live sectors of the block with the fewest to the buffer, which must be empty. As the store holds at most
+// FLASH_STORE_CAPACITY sectors, that block has at least one stale slot, so the buffer always fits in a free block.
+// The moved sectors stay in the block until the buffer is programmed into another one, so the buffer isn't dirty.
+static void reclaim(void)
+{
+  uint32_t victim = 0;
+  for (uint32_t b = 0; b < FLASH_STORE_BLOCKS; b++)
+  {
+    if (block_live[b] > 0 && (block_live[victim] == 0 || block_live[b] < block_live[victim]))
+    {
+      victim = b;
+    }
+  }
+  for (uint32_t loc = victim * FLASH_STORE_SLOTS; loc < (victim + 1) * FLASH_STORE_SLOTS; loc++)
+  {
+    uint32_t i = map_find(slot_tags[loc]);
+    if (map[i] == loc + 1)
+    {
+      memcpy(buffer[buffered], slot_data(loc), DISK_BLOCK_SIZE);
+      set_location(i, slot_tags[loc], FLASH_SLOTS + buffered++);
+    }
+  }
+  last_victim = (int)victim;
+}
+
+// Program the buffer into a free block
+static void flush(void)
+{
+  static uint8_t header_page[DISK_BLOCK_SIZE];
+  int b = find_free_block();
+  assert(b >= 0);
+
+  block_header_t *header = (block_header_t *)header_page;
+  memset(header_page, 0xff, sizeof(header_page));
+  header->magic = STORE_MAGIC;
+  header->seq = next_seq++;
+  for (uint32_t i = 0; i < FLASH_STORE_SLOTS; i++)
+  {
+    header->tags[i] = i < buffered ? slot_tags[FLASH_SLOTS + i] : TAG_EMPTY;
+  }
+  header->crc = header_crc(header);
+
+  // The header goes last, so a block cut short by a power loss is ignored at boot
+  uint32_t offset = STORE_FLASH_OFFSET + (uint32_t)b * FLASH_STORE_BLOCK_SIZE;
+  uint32_t status = save_and_disable_interrupts();
+  flash_range_erase(offset, FLASH_STORE_BLOCK_SIZE);
+  flash_range_program(offset + DISK_BLOCK_SIZE, &buffer[0][0], buffered * DISK_BLOCK_SIZE);
+  flash_range_program(offset, header_page, sizeof(header_page));
+  restore_interrupts(status);
+
+  if (memcmp(STORE_BLOCK(b), header_page, sizeof(header_page)) != 0 ||
+      memcmp(STORE_BLOCK(b) + DISK_BLOCK_SIZE, buffer, buffered * DISK_BLOCK_SIZE) != 0)
+  {
+    printf("### STORE: FLASH WRITE FAILED ###\r\n");
+    return; // the sectors stay in the buffer
+  }
+
+  for (uint32_t i = 0; i < buffered; i++)
+  {
+    uint32_t tag = slot_tags[FLASH_SLOTS + i];
+    set_location(map_find(tag), tag, (uint32_t)b * FLASH_STORE_SLOTS + i);
+  }
+  block_seq[b] = header->seq;
+  buffered = 0;
+  dirty = false;
+  head = ((uint32_t)b + 1) % FLASH_STORE_BLOCKS;
+
+  // One block for the next buffer, and the one its reclaimed sectors came from
+  if (free_blocks() < 2)
+  {
+    reclaim();
+  }
+}
+
+// Erasing and programming a block takes tens of ms with interrupts disabled, too long for a USB callback
+static uint32_t store_task(void)
+{
+  if (!dirty && buffered < FLASH_STORE_SLOTS)
+  {
+    sync_requested = false;
+    return SCHED_IDLE; // woken by flash_store_write()
+  }
+  uint32_t idle_ms = board_millis() - last_write_ms;
+  if (buffered < FLASH_STORE_SLOTS && !sync_requested && idle_ms < FLASH_STORE_FLUSH_MS)
+  {
+    return FLASH_STORE_FLUSH_MS - idle_ms; // more sectors may come
+  }
+  sync_requested = false;
+  flush();
+  return dirty ? FLASH_STORE_FLUSH_MS : SCHED_IDLE; // retried if programming failed
+}
+
+void flash_store_init(void)
+{
+  extern char __flash_binary_end;
+  if ((uintptr_t)&__flash_binary_end > XIP_BASE + STORE_FLASH_OFFSET)
+  {
+    return; // the firmware reaches into the store, logged by flash_store_log()
+  }
+
+  for (uint32_t loc = 0; loc < LOCATIONS; loc++)
+  {
+    slot_tags[loc] = TAG_EMPTY;
+  }
+  uint32_t newest = FLASH_STORE_BLOCKS - 1;
+  for (uint32_t b = 0; b < FLASH_STORE_BLOCKS; b++)
+  {
+    block_header_t const *header = (block_header_t const *)STORE_BLOCK(b);
+    if (header->magic != STORE_MAGIC || header->crc != header_crc(header))
+    {
+      continue; // erased, or cut short
+    }
+    block_seq[b] = header->seq;
+    if (header->seq >= next_seq)
+    {
+      next_seq = header->seq + 1;
+      newest = b;
+    }
+    for (uint32_t i = 0; i < FLASH_STORE_SLOTS; i++)
+    {
+      uint32_t tag = header->tags[i];
+      if (tag == TAG_EMPTY)
+      {
+        continue;
+      }
+      uint32_t m = map_find(tag);
+      if (map[m] == 0 || block_seq[(map[m] - 1u) / FLASH_STORE_SLOTS] < header->seq)
+      {
+        set_location(m, tag, b * FLASH_STORE_SLOTS + i);
+      }
+    }
+  }
+  head = (newest + 1) % FLASH_STORE_BLOCKS;
+  if (free_blocks() < 2)
+  {
+    reclaim();
+  }
+
+  enabled = true;
+  store_task_id = sched_add("store", store_task);
+}
+
+void flash_store_log(void)
+{
+  if (!enabled)
+  {
+    printf("### STORE: OFF, THE FIRMWARE OVERLAPS THE STORE ###\r\n");
+    return;
+  }
+  printf("### STORE: %lu OF %lu SECTORS, %lu FREE BLOCKS ###\r\n", (unsigned long)live,
+         (unsigned long)FLASH_STORE_CAPACITY, (unsigned long)free_blocks());
+}
+
+bool HOT_FUNC(flash_store_read)(uint8_t lun, uint32_t lba, uint8_t *sector)
+{
+  if (!enabled)
+  {
+    return false;
+  }
+  uint32_t i = map_find(TAG(lun, lba));
+  if (map[i] == 0)
+  {
+    return false;
+  }
+  memcpy(sector, slot_data(map[i] - 1u), DISK_BLOCK_SIZE);
+  return true;
+}
+
+bool HOT_FUNC(flash_store_holds)(uint8_t lun, uint32_t lba)
+{
+  return enabled && map[map_find(TAG(lun, lba))] != 0;
+}
+
+int32_t HOT_FUNC(flash_store_write)(uint8_t lun, uint32_t lba, uint8_t const *data, uint32_t bufsize)
+{
+  if (!enabled)
+  {
+    return (int32_t)bufsize; // discarded
+  }
+
+  uint32_t off = 0;
+  for (; off + DISK_BLOCK_SIZE <= bufsize; off += DISK_BLOCK_SIZE, lba++)
+  {
+    uint32_t tag = TAG(lun, lba);
+    uint32_t i = map_find(tag);
+    if (map[i] != 0 && map[i] - 1u >= FLASH_SLOTS)
+    {
+      memcpy(buffer[map[i] - 1u - FLASH_SLOTS], data + off, DISK_BLOCK_SIZE); // written again before programming
+      continue;
+    }
+    if (map[i] == 0 && live >= FLASH_STORE_CAPACITY)
+    {
+      printf("### STORE: FULL, LBA=%lu NOT STORED ###\r\n", (unsigned long)lba);
+      if (off == 0)
+      {
+        return -1;
+      }
+      break;
+    }
+    if (buffered == FLASH_STORE_SLOTS)
+    {
+      break; // taken once the buffer is programmed
+    }
+    memcpy(buffer[buffered], data + off, DISK_BLOCK_SIZE);
+    set_location(i, tag, FLASH_SLOTS + buffered++);
+  }
+
+  dirty = dirty || off > 0;
+  last_write_ms = board_millis();
+  sched_wake(store_task_id);
+  return (int32_t)off;
+}
+
+void flash_store_sync(void)
+{
+  sync_requested = true;
+  sched_wake(store_task_id);
+}
+
+#endif
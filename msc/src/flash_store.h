@@ -0,0 +1,100 @@
+#ifndef FLASH_STORE_H_
+#define FLASH_STORE_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Persistent sectors
+// With FLASH_STORE=1, the sectors the host writes are kept in the flash below the plan sector (extract_plan.c), so
+// the volume behaves as a real drive and the instrument finds its files again after a power cycle. Sectors that
+// were never written still come from the disk image (disk_image.h).
+//
+// The store is a log of erase blocks (4 KB flash sectors). Each block holds FLASH_STORE_SLOTS sectors and a header
+// with their LBAs and a sequence number, and is always written whole. Written sectors are collected in a RAM buffer
+// first, where a sector written again (such as a FAT sector) simply replaces the buffered copy, so a whole block is
+// erased and programmed once per FLASH_STORE_SLOTS new sectors instead of once per host write. A task programs the
+// buffer when it is full, when the host stops writing for FLASH_STORE_FLUSH_MS, or on SYNCHRONIZE CACHE and eject.
+// At boot the headers are scanned into a RAM table from LBA to slot, the highest sequence number winning. When no
+// block is left free, the live sectors of the block with the fewest are moved to the buffer, freeing it.
+//
+// The store holds at most FLASH_STORE_CAPACITY different sectors, fewer than the volume has. Writes to further
+// sectors fail with a write error.
+
+#ifndef FLASH_STORE
+#define FLASH_STORE 0 // 1: keep the written sectors in flash
+#endif
+
+#ifndef FLASH_STORE_SIZE
+#define FLASH_STORE_SIZE (1024 * 1024) // flash used by the store, a multiple of 4 KB
+#endif
+
+#ifndef FLASH_STORE_FLUSH_MS
+#define FLASH_STORE_FLUSH_MS 200 // program the buffer once the host has stopped writing for this long
+#endif
+
+#define FLASH_STORE_BLOCK_SIZE 4096                    // flash erase block
+#define FLASH_STORE_SLOTS 7                            // sectors per block, after a sector sized header
+#define FLASH_STORE_BLOCKS (FLASH_STORE_SIZE / FLASH_STORE_BLOCK_SIZE)
+#define FLASH_STORE_CAPACITY ((FLASH_STORE_BLOCKS - 2) * FLASH_STORE_SLOTS) // two blocks are kept for reclaiming
+
+#if FLASH_STORE
+
+// Rebuild the LBA table from the flash and add the task that programs the buffer. Before the first SCSI command.
+void flash_store_init(void);
+
+// Copy the stored sector to sector and return true, or return false if the host never wrote it
+bool flash_store_read(uint8_t lun, uint32_t lba, uint8_t *sector);
+
+// Whether the host has written the sector
+bool flash_store_holds(uint8_t lun, uint32_t lba);
+
+// Store the written sectors. Returns the number of bytes taken, which is less than bufsize when the buffer is full
+// (the host retries the rest once it has been programmed), or -1 when the store has no room for a new sector.
+int32_t flash_store_write(uint8_t lun, uint32_t lba, uint8_t const *buffer, uint32_t bufsize);
+
+// Program the buffer now, e.g. before the host powers the drive down
+void flash_store_sync(void);
+
+// Log how full the store is
+void flash_store_log(void);
+
+#else
+
+static inline void flash_store_init(void)
+{
+}
+
+static inline bool flash_store_read(uint8_t lun, uint32_t lba, uint8_t *sector)
+{
+  (void)lun;
+  (void)lba;
+  (void)sector;
+  return false;
+}
+
+static inline bool flash_store_holds(uint8_t lun, uint32_t lba)
+{
+  (void)lun;
+  (void)lba;
+  return false;
+}
+
+static inline int32_t flash_store_write(uint8_t lun, uint32_t lba, uint8_t const *buffer, uint32_t bufsize)
+{
+  (void)lun;
+  (void)lba;
+  (void)buffer;
+  return (int32_t)bufsize; // discarded
+}
+
+static inline void flash_store_sync(void)
+{
+}
+
+static inline void flash_store_log(void)
+{
+}
+
+#endif
+
+#endif /* FLASH_STORE_H_ */
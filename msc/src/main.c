@@ -27,8 +27,18 @@
 #include "tusb.h"
 #include "hardware/uart.h"
 #include "hardware/gpio.h"
+#include "hardware/sync.h"
+#include "hardware/structs/scb.h"
 #include <stdio.h>
 #include "pico/stdlib.h"
+#include "sched.h"
+#include "extract_plan.h"
+#include "config_file.h"
+#include "boot_time.h"
+#include "cb_timing.h"
+#include "scsi_recorder.h"
+#include "flash_store.h"
+#include "clock_governor.h"
 
 // UART defines
 #define BAUD_RATE 9600 // 115200
@@ -53,36 +63,111 @@ enum
 
 static uint32_t blink_interval_ms = BLINK_NOT_MOUNTED;
 
-void led_blinking_task(void);
-void button_press_task(void);
+// Tasks are run by the scheduler (common/sched.c). They return the number of ms until they next need to run,
+// or SCHED_IDLE when they have no work and will be woken by an interrupt.
+uint32_t usb_task(void);
+uint32_t led_blinking_task(void);
+uint32_t button_press_task(void);
+uint32_t stats_task(void);
+
+static int usb_task_id;
+
+static void wait_for_event(uint32_t sleep_ms);
 
 /*------------- MAIN -------------*/
 int main(void)
 {
+  boot_mark(BOOT_MAIN);
+
+  // Only what the host can see during enumeration is set up before USB, and nothing is logged: a line on the debug
+  // UART blocks for several ms. The rest waits until the pull-up is on.
   stdio_init_all();
   board_init();
 
-  // Set up UART
-  uart_init(uart1, BAUD_RATE);
-  gpio_set_function(UART_TX_PIN, GPIO_FUNC_UART);
-  gpio_set_function(UART_RX_PIN, GPIO_FUNC_UART);
+  // Before USB is up, so the host never sees the defaults if a plan is stored in flash
+  extract_plan_init();
 
   // init device stack on configured roothub port
   tusb_rhport_init_t dev_init = {
       .role = TUSB_ROLE_DEVICE,
       .speed = TUSB_SPEED_AUTO};
   tusb_init(BOARD_TUD_RHPORT, &dev_init);
+  boot_mark(BOOT_USB_CONNECT);
 
   if (board_init_after_tusb)
   {
     board_init_after_tusb();
   }
 
+  // Before the UARTs' baud rates are set up, as it moves their clock
+  clock_governor_init();
+
+  // Set up UART, only used once the host writes a file
+  uart_init(uart1, BAUD_RATE);
+  gpio_set_function(UART_TX_PIN, GPIO_FUNC_UART);
+  gpio_set_function(UART_RX_PIN, GPIO_FUNC_UART);
+
+  // Any interrupt that becomes pending wakes the core from __wfe(), even one raised just before going to sleep
+  scb_hw->scr |= M33_SCR_SEVONPEND_BITS;
+
+  usb_task_id = sched_add("usb", usb_task);
+  sched_add("led", led_blinking_task);
+  sched_add("button", button_press_task);
+  sched_add("stats", stats_task);
+  config_file_init();
+  boot_time_init();
+  cb_timing_init();
+  scsi_recorder_init();
+  flash_store_init();
+
   while (1)
   {
-    tud_task(); // tinyusb device task
-    led_blinking_task();
-    button_press_task();
+    if (tud_task_event_ready())
+    {
+      sched_wake(usb_task_id);
+    }
+    wait_for_event(sched_run());
+  }
+}
+
+uint32_t usb_task(void)
+{
+  tud_task(); // tinyusb device task, the SCSI callbacks run from here
+  return SCHED_IDLE; // woken when the USB interrupt queues an event
+}
+
+// Log the run time of each task, to show which one dominates the CPU, and the cycles spent in the SCSI callbacks
+uint32_t stats_task(void)
+{
+  const uint32_t interval_ms = 60000;
+  static bool first_run = true;
+
+  if (!first_run)
+  {
+    sched_print_stats();
+    sched_reset_stats();
+    cb_timing_print();
+    cb_timing_reset();
+    clock_governor_log();
+  }
+  first_run = false;
+  return interval_ms;
+}
+
+// Sleep until a USB interrupt or until the next task is due
+static void wait_for_event(uint32_t sleep_ms)
+{
+  if (sleep_ms == 0 || tud_task_event_ready())
+  {
+    return;
+  }
+  if (sleep_ms == SCHED_IDLE)
+  {
+    __wfe();
+  }
+  else
+  {
+    best_effort_wfe_or_timeout(make_timeout_time_ms(sleep_ms));
   }
 }
 
@@ -93,6 +178,7 @@ int main(void)
 // Invoked when device is mounted
 void tud_mount_cb(void)
 {
+  boot_mark(BOOT_MOUNTED);
   printf("### DEVICE MOUNTED ###\r\n");
 
   blink_interval_ms = BLINK_MOUNTED;
@@ -128,17 +214,12 @@ void tud_resume_cb(void)
 // BUTTON PRESS TASK
 // Press the button to test device integration
 //--------------------------------------------------------------------+
-void button_press_task(void)
+uint32_t button_press_task(void)
 {
   static bool pressed = false;
 
-  // Poll every 10ms
+  // Poll every 10ms. The button has no interrupt, so this task always has work.
   const uint32_t interval_ms = 10;
-  static uint32_t start_ms = 0;
-
-  if (board_millis() - start_ms < interval_ms)
-    return; // not enough time
-  start_ms += interval_ms;
 
   bool btn = board_button_read();
 
@@ -151,21 +232,19 @@ void button_press_task(void)
   if (!btn && pressed) {
     pressed = false;
   }
+  return interval_ms;
 }
 
 //--------------------------------------------------------------------+
 // BLINKING TASK
 //--------------------------------------------------------------------+
-void led_blinking_task(void)
+uint32_t led_blinking_task(void)
 {
-  static uint32_t start_ms = 0;
   static bool led_state = false;
 
-  // Blink every interval ms
-  if (board_millis() - start_ms < blink_interval_ms)
-    return; // not enough time
-  start_ms += blink_interval_ms;
-
   board_led_write(led_state);
   led_state = 1 - led_state; // toggle
+
+  // Blink every interval ms
+  return blink_interval_ms;
 }
\ No newline at end of file
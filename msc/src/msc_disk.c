@@ -26,20 +26,56 @@
 #include "bsp/board_api.h"
 #include "tusb.h"
 #include "hardware/uart.h"
-#include "disk.h"
+#include "disk_layout.h"
+#include "disk_image.h"
+#include "csv_extract.h"
+#include "file_capture.h"
+#include "record_dedup.h"
+#include "extract_plan.h"
+#include "config_file.h"
+#include "msc_lun.h"
+#include "fixed_point.h"
+#include "column_stats.h"
+#include "boot_time.h"
+#include "cb_timing.h"
+#include "scsi_recorder.h"
+#include "flash_store.h"
+#include "clock_governor.h"
+#include "hot_path.h"
 
-// Whether host does safe-eject
-static bool ejected = false;
+// Extraction mode
+// 0: each written sector is searched on its own for the CSV field
+// 1: whole-file capture, the field is searched for in each file as its sectors are followed in cluster order
+#ifndef FILE_CAPTURE
+#define FILE_CAPTURE 1
+#endif
+
+// Whether host does safe-eject, per LUN
+static bool ejected[MSC_LUNS];
+
+// Record a command that TinyUSB answers itself. Only the opcode and the flags TinyUSB passes on are known.
+static void record_command(uint8_t lun, uint8_t opcode, uint8_t flags)
+{
+  uint8_t cdb[SCSI_RECORD_CDB_SIZE] = {opcode};
+  cdb[4] = flags;
+  scsi_record_command(lun, cdb);
+}
+
+// Invoked when received GET_MAX_LUN request, returns the number of LUNs
+uint8_t tud_msc_get_maxlun_cb(void)
+{
+  return MSC_LUNS;
+}
 
 // Invoked when received SCSI_CMD_INQUIRY
 void tud_msc_inquiry_cb(uint8_t lun, uint8_t vendor_id[8], uint8_t product_id[16], uint8_t product_rev[4])
 {
-  (void)lun;
-
-  printf("### SCSI INQUIRY ###\r\n");
+  boot_mark(BOOT_FIRST_SCSI);
+  record_command(lun, SCSI_CMD_INQUIRY, 0);
+  printf("### SCSI INQUIRY: LUN=%u ###\r\n", lun);
 
   const char vid[] = "TinyUSB";
-  const char pid[] = "Mass Storage";
+  const char *pid = msc_luns[lun].product;
   const char rev[] = "1.0";
   memcpy(vendor_id, vid, strlen(vid));
   memcpy(product_id, pid, strlen(pid));
@@ -49,11 +85,10 @@ void tud_msc_inquiry_cb(uint8_t lun, uint8_t vendor_id[8], uint8_t product_id[16
 // Invoked when received Test Unit Ready command
 bool tud_msc_test_unit_ready_cb(uint8_t lun)
 {
-  (void)lun;
-
+  record_command(lun, SCSI_CMD_TEST_UNIT_READY, 0);
   printf("### TEST UNIT READY ###\r\n");
 
-  if (ejected)
+  if (ejected[lun])
   {
     tud_msc_set_sense(lun, SCSI_SENSE_NOT_READY, 0x3a, 0x00);
     return false;
@@ -64,45 +99,129 @@ bool tud_msc_test_unit_ready_cb(uint8_t lun)
 // Invoked when received SCSI_CMD_READ_CAPACITY_10
 void tud_msc_capacity_cb(uint8_t lun, uint32_t *block_count, uint16_t *block_size)
 {
-  (void)lun;
-
-  printf("### SCSI READ CAPACITY ###\r\n");
+  record_command(lun, SCSI_CMD_READ_CAPACITY_10, 0);
+  printf("### SCSI READ CAPACITY: LUN=%u ###\r\n", lun);
 
-  *block_count = DISK_BLOCK_NUM - 1; // Last LBA
+  *block_count = msc_luns[lun].block_count - 1; // Last LBA
   *block_size = DISK_BLOCK_SIZE;
 }
 
 // Invoked when received Start Stop Unit command
 bool tud_msc_start_stop_cb(uint8_t lun, uint8_t power_condition, bool start, bool load_eject)
 {
-  (void)lun;
-  (void)power_condition;
-
+  record_command(lun, SCSI_CMD_START_STOP_UNIT, (uint8_t)(power_condition << 4 | load_eject << 1 | start));
   printf("### START STOP UNIT ###\r\n");
 
   if (load_eject)
   {
     if (!start)
     {
-      ejected = true;
+      ejected[lun] = true;
+      flash_store_sync();
     }
   }
   return true;
 }
 
-// Callback for unhandled SCSI commands
-int32_t tud_msc_scsi_cb(uint8_t lun, uint8_t const scsi_cmd[16], void *buffer, uint16_t bufsize)
+// SCSI commands that TinyUSB leaves to tud_msc_scsi_cb
+// Each command is answered from the table without a debug log, so a host probing the drive isn't slowed down by the
+// UART. A command that isn't in the table fails at once with ILLEGAL REQUEST instead of being retried by the host.
+#define SCSI_CMD_VERIFY_10 0x2F
+#define SCSI_CMD_SYNCHRONIZE_CACHE_10 0x35
+#define SCSI_CMD_MODE_SENSE_10 0x5A
+#define SCSI_CMD_SERVICE_ACTION_IN_16 0x9E
+#define SCSI_SA_READ_CAPACITY_16 0x10
+
+#define SCSI_ASC_WRITE_ERROR 0x0C
+#define SCSI_ASC_INVALID_COMMAND 0x20
+#define SCSI_ASC_INVALID_FIELD_IN_CDB 0x24
+
+typedef struct
 {
+  uint8_t opcode;
+  uint8_t response_len;
+  uint8_t const *response; // fixed response, used when there is no handler
+  int32_t (*handler)(uint8_t lun, uint8_t const scsi_cmd[16], uint8_t *buffer, uint16_t bufsize);
+} scsi_cmd_t;
+
+// Mode parameter header: no medium type, not write protected, no block descriptors
+static uint8_t const HOT_DATA("scsi") mode_sense_10_response[8] = {0x00, 0x06, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00};
+
+static int32_t read_capacity_16(uint8_t lun, uint8_t const scsi_cmd[16], uint8_t *buffer, uint16_t bufsize)
+{
+  if ((scsi_cmd[1] & 0x1f) != SCSI_SA_READ_CAPACITY_16)
+  {
+    tud_msc_set_sense(lun, SCSI_SENSE_ILLEGAL_REQUEST, SCSI_ASC_INVALID_FIELD_IN_CDB, 0x00);
+    return -1;
+  }
+
+  uint8_t response[32] = {0};
+  uint32_t last_lba = msc_luns[lun].block_count - 1;
+  response[4] = (uint8_t)(last_lba >> 24); // big endian, the upper 32 bits stay 0
+  response[5] = (uint8_t)(last_lba >> 16);
+  response[6] = (uint8_t)(last_lba >> 8);
+  response[7] = (uint8_t)last_lba;
+  response[10] = (uint8_t)(DISK_BLOCK_SIZE >> 8);
+  response[11] = (uint8_t)DISK_BLOCK_SIZE;
+
+  uint16_t len = bufsize < sizeof(response) ? bufsize : sizeof(response);
+  memcpy(buffer, response, len);
+  return len;
+}
+
+static int32_t synchronize_cache(uint8_t lun, uint8_t const scsi_cmd[16], uint8_t *buffer, uint16_t bufsize)
+{
+  (void)lun;
+  (void)scsi_cmd;
+  (void)buffer;
+  (void)bufsize;
+  flash_store_sync(); // the sectors buffered by the store are programmed right after this command
+  return 0;
+}
+
+static scsi_cmd_t const HOT_DATA("scsi") scsi_cmds[] = {
+    {SCSI_CMD_PREVENT_ALLOW_MEDIUM_REMOVAL, 0, NULL, NULL}, // the medium can't be removed anyway
+    {SCSI_CMD_VERIFY_10, 0, NULL, NULL},                    // the sectors are always readable
+    {SCSI_CMD_SYNCHRONIZE_CACHE_10, 0, NULL, synchronize_cache},
+    {SCSI_CMD_MODE_SENSE_10, sizeof(mode_sense_10_response), mode_sense_10_response, NULL},
+    {SCSI_CMD_SERVICE_ACTION_IN_16, 0, NULL, read_capacity_16},
+};
+
+// Callback for the SCSI commands that aren't handled by TinyUSB
+int32_t HOT_FUNC(tud_msc_scsi_cb)(uint8_t lun, uint8_t const scsi_cmd[16], void *buffer, uint16_t bufsize)
+{
+  scsi_record_command(lun, scsi_cmd);
+  for (uint32_t i = 0; i < TU_ARRAY_SIZE(scsi_cmds); i++)
+  {
+    scsi_cmd_t const *cmd = &scsi_cmds[i];
+    if (cmd->opcode != scsi_cmd[0])
+    {
+      continue;
+    }
+    if (cmd->handler)
+    {
+      return cmd->handler(lun, scsi_cmd, buffer, bufsize);
+    }
+    uint16_t len = bufsize < cmd->response_len ? bufsize : cmd->response_len;
+    if (len > 0)
+    {
+      memcpy(buffer, cmd->response, len);
+    }
+    return len;
+  }
+
   printf("### UNHANDLED SCSI COMMAND: 0x%02X ###\r\n", scsi_cmd[0]);
+  tud_msc_set_sense(lun, SCSI_SENSE_ILLEGAL_REQUEST, SCSI_ASC_INVALID_COMMAND, 0x00);
+  return -1;
 }
 
   // Callback for READ10 command
-  int32_t tud_msc_read10_cb(uint8_t lun, uint32_t lba, uint32_t offset, void *buffer, uint32_t bufsize)
+  int32_t HOT_FUNC(tud_msc_read10_cb)(uint8_t lun, uint32_t lba, uint32_t offset, void *buffer, uint32_t bufsize)
   {
-    (void)lun;
-
+#if !SCSI_RECORD // the recording has the LBAs, and a line per sector would hold up its frames
     // Debug: Log block reads to UART
     printf("### READ: LBA=%lu ###\r\n", lba);
+#endif
 
     if (offset != 0)
     {
@@ -114,55 +233,281 @@ int32_t tud_msc_scsi_cb(uint8_t lun, uint8_t const scsi_cmd[16], void *buffer, u
       printf("### BUFSIZE=%lu ###\r\n", bufsize);
     }
 
-    if (lba == 0)
+    if (lba >= msc_luns[lun].block_count)
     {
-      memcpy(buffer, lba_0, DISK_BLOCK_SIZE);
+      return -1; // past the end of this LUN's volume
     }
-    else if (lba == 4)
+    clock_governor_activity(false);
+
+    uint32_t start = cb_timing_start(); // after the debug log, which is paced by the UART
+    for (uint32_t off = 0; off + DISK_BLOCK_SIZE <= bufsize; off += DISK_BLOCK_SIZE)
     {
-      memcpy(buffer, lba_4, DISK_BLOCK_SIZE);
+      uint8_t *sector = (uint8_t *)buffer + off;
+      if (!flash_store_read(lun, lba + off / DISK_BLOCK_SIZE, sector))
+      {
+        disk_image_read(lba + off / DISK_BLOCK_SIZE, sector);
+      }
     }
-    else if (lba == 68)
+
+    msc_lun_read(lun, lba, buffer, bufsize);
+
+#if FILE_CAPTURE
+    // A CONFIG.TXT written back only arrives through the file capture, so without it the file isn't shown
+    config_file_read(lun, lba, buffer, bufsize);
+    file_capture_read(lun, lba, buffer, bufsize);
+#endif
+
+    cb_timing_end(CB_READ10, start);
+    scsi_record_transfer(SCSI_RECORD_READ10, lun, lba, buffer, bufsize); // as the host gets it
+    return (int32_t)bufsize;
+  }
+
+  bool tud_msc_is_writable_cb(uint8_t lun)
+  {
+    (void)lun;
+
+    printf("### IS WRITABLE ###\r\n");
+
+    return true;
+  }
+
+  // Callback for WRITE10 command
+  // Where a line comes from, for the duplicate check: the LUN, the file name (NULL if not known) and the row
+  static uint32_t line_source(uint8_t lun, char const *name, uint32_t row)
+  {
+    uint32_t crc = dedup_crc32(0, &lun, 1);
+    if (name)
     {
-      memcpy(buffer, lba_68, DISK_BLOCK_SIZE);
+      crc = dedup_crc32(crc, (uint8_t const *)name, (uint32_t)strlen(name));
     }
-    else if (lba == 132)
+    return dedup_crc32(crc, (uint8_t const *)&row, sizeof(row));
+  }
+
+  // Send a line of text to the HID device
+  static void send_line(uint32_t source, uint8_t const *text, int32_t len)
+  {
+    // A file the instrument saves again would otherwise type the same reading twice. The same value from another
+    // file or row is a new reading.
+    if (dedup_is_duplicate(dedup_crc32(source, text, (uint32_t)len), board_millis()))
     {
-      memcpy(buffer, lba_132, DISK_BLOCK_SIZE);
+      printf("### DUPLICATE DATA SUPPRESSED ###\r\n");
+      return;
     }
-    else if (lba == 168)
+
+    printf("### DATA=");
+    for (const uint8_t *p = text; p < text + len; p++)
     {
-      memcpy(buffer, lba_168, DISK_BLOCK_SIZE);
+      uart_putc_raw(uart1, *p);
+      printf("%c", *p);
     }
-    else // lba_1 is all zeros
+    uart_putc_raw(uart1, '\n');
+    printf(" ###\r\n");
+  }
+
+#define NUMBER_MAX (FIXED_MAX_DECIMALS + 12) // a number as it is sent
+
+  // Numbers are sent in one form, whatever the instrument wrote. Returns the length of the number written to text,
+  // or -1 if the field isn't a number.
+  static int32_t format_number(extract_plan_t const *plan, uint8_t const *field, int32_t len, char text[NUMBER_MAX])
+  {
+    fixed_t value;
+    if (!fixed_parse(field, (uint32_t)len, &value) ||
+        (plan->decimals != PLAN_DECIMALS_AUTO && !fixed_rescale(&value, plan->decimals)))
     {
-      memcpy(buffer, lba_1, DISK_BLOCK_SIZE);
+      printf("### NOT A NUMBER: %.*s ###\r\n", (int)len, field);
+      return -1;
     }
+    return (int32_t)fixed_format(&value, (char)plan->point, text, NUMBER_MAX);
+  }
 
-    return (int32_t)bufsize;
+  // Send an extracted field, one line per reading
+  static void send_field(uint32_t source, extract_plan_t const *plan, uint8_t const *field, int32_t len)
+  {
+    char number[NUMBER_MAX];
+    if (plan->decimals != PLAN_DECIMALS_TEXT)
+    {
+      len = format_number(plan, field, len, number);
+      if (len < 0)
+      {
+        return;
+      }
+      field = (uint8_t const *)number;
+    }
+    send_line(source, field, len);
   }
 
-  bool tud_msc_is_writable_cb(uint8_t lun)
+  // Extraction from a file that is fed a sector at a time
+  // Only what the plan asks for is kept between sectors: the field of its row, the newest rows of ROW=LAST or the
+  // running statistics. The memory is the same however long the file grows.
+  typedef struct
   {
-    (void)lun;
+    extract_plan_t plan; // as the file started, a CONFIG.TXT saved meanwhile applies from the next file
+    union
+    {
+      csv_scan_t scan; // ROW=n
+      csv_tail_t tail; // ROW=LAST
+    };
+    column_stats_t stats;
+    uint32_t skipped;       // fields from the first row on that aren't numbers
+    bool found;             // the field of ROW=n was seen
+    csv_tail_field_t field; // and here it is
+  } file_extract_t;
 
-    printf("### IS WRITABLE ###\r\n");
+  static void stats_add(file_extract_t *x, uint8_t const *field, uint32_t len, bool truncated)
+  {
+    fixed_t value;
+    if (truncated || !fixed_parse(field, len, &value) || !column_stats_add(&x->stats, &value))
+    {
+      x->skipped++;
+    }
+  }
 
-    return true;
+  static void extract_field_cb(void *ctx, uint32_t row, uint8_t const *field, uint32_t len, bool truncated)
+  {
+    file_extract_t *x = ctx;
+    if (x->plan.stats)
+    {
+      if (row >= x->plan.row)
+      {
+        stats_add(x, field, len, truncated);
+      }
+    }
+    else if (row == x->plan.row && !x->found)
+    {
+      x->found = true;
+      x->field.row = row;
+      x->field.len = (uint8_t)len;
+      x->field.truncated = truncated;
+      memcpy(x->field.field, field, len);
+    }
   }
 
-  // Callback for WRITE10 command
-  const int ROW = 5;
-  const int COL = 2;
-  int32_t tud_msc_write10_cb(uint8_t lun, uint32_t lba, uint32_t offset, uint8_t *buffer, uint32_t bufsize)
+  static void extract_start(file_extract_t *x, extract_plan_t const *plan)
+  {
+    x->plan = *plan;
+    if (plan->row == PLAN_ROW_LAST)
+    {
+      csv_tail_init(&x->tail, plan->delim, plan->col, plan->rows);
+    }
+    else
+    {
+      csv_scan_init(&x->scan, plan->delim, plan->col);
+    }
+    column_stats_init(&x->stats);
+    x->skipped = 0;
+    x->found = false;
+  }
+
+  static void extract_feed(file_extract_t *x, uint8_t const *data, uint32_t len)
+  {
+    if (x->plan.row == PLAN_ROW_LAST)
+    {
+      csv_tail_feed(&x->tail, data, len);
+    }
+    else if (!x->found) // nothing after the row of the field is needed
+    {
+      csv_scan_feed(&x->scan, data, len, extract_field_cb, x);
+    }
+  }
+
+  // Send the newest rows of the plan's column as one line, the oldest first, separated by tabs so they land in
+  // neighbouring cells
+  static void send_last_rows(file_extract_t const *x, uint32_t source)
+  {
+    char line[CSV_TAIL_ROWS_MAX * (CSV_SCAN_FIELD_MAX + 1)];
+    uint32_t len = 0;
+    for (uint32_t i = 0; i < csv_tail_count(&x->tail); i++)
+    {
+      csv_tail_field_t const *f = csv_tail_field(&x->tail, i);
+      char *text = &line[len > 0 ? len + 1 : 0];
+      int32_t n = f->len;
+      if (f->truncated)
+      {
+        printf("### FIELD TOO LONG: ROW %lu ###\r\n", (unsigned long)f->row);
+        continue;
+      }
+      if (x->plan.decimals == PLAN_DECIMALS_TEXT)
+      {
+        memcpy(text, f->field, f->len);
+      }
+      else if ((n = format_number(&x->plan, f->field, f->len, text)) < 0)
+      {
+        continue;
+      }
+      if (len > 0)
+      {
+        line[len++] = '\t';
+      }
+      len += (uint32_t)n;
+    }
+    if (len > 0)
+    {
+      send_line(source, (uint8_t const *)line, (int32_t)len);
+    }
+  }
+
+  // Send the statistics of the plan's column as one line
+  static void send_stats(file_extract_t const *x, uint32_t source)
+  {
+    char line[5 * (FIXED_MAX_DECIMALS + 12)];
+    uint32_t len = column_stats_format(&x->stats, x->plan.decimals, (char)x->plan.point, line, sizeof(line));
+    printf("### STATS: %lu VALUES, %lu SKIPPED ###\r\n", (unsigned long)x->stats.count, (unsigned long)x->skipped);
+    if (len > 0)
+    {
+      send_line(source, (uint8_t const *)line, (int32_t)len);
+    }
+  }
+
+  // End of the file: send what was extracted from it. Lines are told apart by the LUN, the file name and the row,
+  // the newest one with ROW=LAST.
+  static void extract_finish(file_extract_t *x, uint8_t lun, char const *name)
+  {
+    uint32_t row = x->plan.row;
+    if (x->plan.row == PLAN_ROW_LAST)
+    {
+      csv_tail_end(&x->tail);
+      uint32_t count = csv_tail_count(&x->tail);
+      row = count > 0 ? csv_tail_field(&x->tail, count - 1)->row : 0;
+      if (!x->plan.stats)
+      {
+        send_last_rows(x, line_source(lun, name, row));
+        return;
+      }
+      for (uint32_t i = 0; i < csv_tail_count(&x->tail); i++) // the statistics of the newest rows only
+      {
+        csv_tail_field_t const *f = csv_tail_field(&x->tail, i);
+        stats_add(x, f->field, f->len, f->truncated);
+      }
+    }
+    else if (!x->found)
+    {
+      csv_scan_end(&x->scan, extract_field_cb, x);
+    }
+
+    if (x->plan.stats)
+    {
+      send_stats(x, line_source(lun, name, row));
+    }
+    else if (x->found && x->field.truncated)
+    {
+      printf("### FIELD TOO LONG: ROW %lu ###\r\n", (unsigned long)x->field.row);
+    }
+    else if (x->found)
+    {
+      send_field(line_source(lun, name, row), &x->plan, x->field.field, x->field.len);
+    }
+  }
+
+  int32_t HOT_FUNC(tud_msc_write10_cb)(uint8_t lun, uint32_t lba, uint32_t offset, uint8_t *buffer, uint32_t bufsize)
   {
-    (void)lun;
     (void)offset;
 
     char msg[64];
 
+#if !SCSI_RECORD
     // Debug: Log block writes to UART
     printf("### WRITE: LBA=%lu ###\r\n", lba);
+#endif
 
 
     if (offset != 0)
@@ -175,51 +520,73 @@ int32_t tud_msc_scsi_cb(uint8_t lun, uint8_t const scsi_cmd[16], void *buffer, u
       printf("### BUFSIZE=%lu ###\r\n", bufsize);
     }
 
-    // Process ASCII CSV data for UART
-    bool has_comma = false;
-    for (int i = 0; i < bufsize; i++)
+    if (lba >= msc_luns[lun].block_count)
     {
-      if (buffer[i] == ',')
-      {
-        has_comma = true;
-      }
+      return -1; // past the end of this LUN's volume
+    }
+    clock_governor_activity(true); // full speed before the sectors are parsed
+
+    int32_t stored = flash_store_write(lun, lba, buffer, bufsize);
+    if (stored < 0)
+    {
+      tud_msc_set_sense(lun, SCSI_SENSE_MEDIUM_ERROR, SCSI_ASC_WRITE_ERROR, 0x00);
+      return -1; // the store is full
     }
-    if (!has_comma)
+    if (stored == 0)
     {
-      return (int32_t)bufsize;
+      return 0; // TinyUSB calls again once the store has programmed its buffer
     }
-    int row = 0;
-    int col = 0;
-    uint8_t *start = buffer;
-    uint8_t *pos = buffer;
-    while (pos < buffer + bufsize && row <= ROW)
+    bufsize = (uint32_t)stored;
+
+    scsi_record_transfer(SCSI_RECORD_WRITE10, lun, lba, buffer, bufsize);
+    uint32_t start = cb_timing_start();
+#if FILE_CAPTURE
+    file_capture_write(lun, lba, buffer, bufsize);
+#else
+    // Process ASCII CSV data for UART. The FAT and the root directory are never CSV.
+    extract_plan_t const *plan = extract_plan(lun);
+    uint8_t const *field;
+    int32_t len = (lba >= DISK_DATA_LBA) ? csv_extract_field(buffer, bufsize, plan->row, plan->col, plan->delim, &field)
+                                         : -1;
+    if (len >= 0)
     {
-      if (*pos == ',' || *pos == '\n' || *pos == '\0' || pos == buffer + bufsize - 1)
+      send_field(line_source(lun, NULL, plan->row), plan, field, len);
+    }
+#endif
+    cb_timing_end(CB_WRITE10, start);
+    return (int32_t)bufsize;
+  }
+
+  // One extraction per file the host is writing, see file_capture.h
+  static file_extract_t extracts[MSC_LUNS][CAPTURE_STREAMS];
+
+  // Invoked by file_capture.c when the host starts writing a file
+  void file_capture_start_cb(uint8_t lun, uint8_t stream)
+  {
+    extract_start(&extracts[lun][stream], extract_plan(lun));
+  }
+
+  // Invoked by file_capture.c with the next sector of the file
+  void file_capture_data_cb(uint8_t lun, uint8_t stream, uint8_t const *data, uint32_t len)
+  {
+    extract_feed(&extracts[lun][stream], data, len);
+  }
+
+  // Invoked by file_capture.c when the host has finished writing a file
+  void file_capture_done_cb(uint8_t lun, uint8_t stream, fat_file_t const *file, uint8_t const *data, uint32_t len)
+  {
+    if (strcmp(file->name, CONFIG_FILE_NAME) == 0)
+    {
+      if (len != file->size)
       {
-        if (row == ROW && col == COL)
-        {
-          printf("### DATA=");
-          for (const uint8_t *p = start; p < pos; p++)
-          {
-            uart_putc_raw(uart1, *p);
-            printf("%c", *p);
-          }
-          uart_putc_raw(uart1, '\n');
-          printf(" ###\r\n");
-        }
-        if (*pos == ',' || *pos == '\0' || pos == buffer + bufsize - 1)
-        {
-          col++;
-          start = pos + 1;
-        }
-        if (*pos == '\n')
-        {
-          row++;
-          col = 0;
-          start = pos + 1;
-        }
+        printf("### CONFIG: LUN=%u TOO LARGE (%lu) ###\r\n", lun, (unsigned long)file->size);
+        return;
       }
-      pos++;
+      config_file_write(lun, data, len);
+      return;
     }
-    return (int32_t)bufsize;
+
+    file_extract_t *x = &extracts[lun][stream];
+    extract_feed(x, data, len);
+    extract_finish(x, lun, file->name);
   }
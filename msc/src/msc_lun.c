@@ -0,0 +1,71 @@
+#include <assert.h>
+#include <string.h>
+
+#include "msc_lun.h"
+#include "extract_plan.h"
+#include "flash_store.h"
+#include "hot_path.h"
+
+static_assert(MSC_LUNS >= 1 && MSC_LUNS <= MSC_LUN_MAX, "MSC_LUNS must be 1 to MSC_LUN_MAX");
+static_assert(MSC_LUNS < 2 || DISK_BLOCK_NUM / 2 >= MSC_LUN_MIN_BLOCK_NUM,
+              "the second LUN, DISK_BLOCK_NUM / 2 sectors, would be FAT12: raise --sectors in DISK_IMAGE_ARGS");
+
+// LUN 0 is the generated volume as it is, with the label and serial number of DISK_IMAGE_ARGS. The second drive is
+// half the size, for instruments that expect a smaller one, and starts with its own extraction plan.
+msc_lun_t const HOT_DATA("msc_lun") msc_luns[MSC_LUN_MAX] = {
+    {
+        .product = "Mass Storage",
+        .label = DISK_LABEL,
+        .serial = DISK_SERIAL,
+        .block_count = DISK_BLOCK_NUM,
+        .default_row = PLAN_DEFAULT_ROW,
+        .default_col = PLAN_DEFAULT_COL,
+    },
+    {
+        .product = "Mass Storage 2",
+        .label = "LIT 2      ",
+        .serial = DISK_SERIAL + 1,
+        .block_count = DISK_BLOCK_NUM / 2,
+        .default_row = PLAN_DEFAULT_ROW,
+        .default_col = PLAN_DEFAULT_COL,
+    },
+};
+
+// Fields of the boot sector (lba_0)
+#define BOOT_TOTAL_SECTORS_16 19
+#define BOOT_TOTAL_SECTORS_32 32
+#define BOOT_SERIAL 39
+#define BOOT_LABEL 43
+
+static void HOT_FUNC(put_u32)(uint8_t *p, uint32_t v)
+{
+  p[0] = (uint8_t)v;
+  p[1] = (uint8_t)(v >> 8);
+  p[2] = (uint8_t)(v >> 16);
+  p[3] = (uint8_t)(v >> 24);
+}
+
+void HOT_FUNC(msc_lun_read)(uint8_t lun, uint32_t lba, uint8_t *buffer, uint32_t bufsize)
+{
+  msc_lun_t const *l = &msc_luns[lun];
+  for (uint32_t off = 0; off + DISK_BLOCK_SIZE <= bufsize; off += DISK_BLOCK_SIZE, lba++)
+  {
+    uint8_t *sector = buffer + off;
+    if (flash_store_holds(lun, lba))
+    {
+      continue; // the host's own copy, which may have relabelled or reformatted the volume
+    }
+    if (lba == 0)
+    {
+      sector[BOOT_TOTAL_SECTORS_16] = 0; // the size is always given in the 32 bit field
+      sector[BOOT_TOTAL_SECTORS_16 + 1] = 0;
+      put_u32(&sector[BOOT_TOTAL_SECTORS_32], l->block_count);
+      put_u32(&sector[BOOT_SERIAL], l->serial);
+      memcpy(&sector[BOOT_LABEL], l->label, 11);
+    }
+    else if (lba == DISK_ROOT_DIR_LBA)
+    {
+      memcpy(sector, l->label, 11); // the volume label entry
+    }
+  }
+}
@@ -0,0 +1,43 @@
+#ifndef MSC_LUN_H_
+#define MSC_LUN_H_
+
+#include <stdint.h>
+
+#include "disk_layout.h"
+
+// Logical units
+// The MSC device can present several drives, one per LUN. Every drive is the FAT16 volume of disk_image.h, read
+// from the same stored sectors, and the table in msc_lun.c gives each one its own size, label, serial number and
+// default extraction plan. Each LUN also has its own CONFIG.TXT, stored plan and file capture.
+
+#ifndef MSC_LUNS
+#define MSC_LUNS 1 // drives presented to the instrument, up to MSC_LUN_MAX
+#endif
+
+#define MSC_LUN_MAX 2 // entries in the table
+
+// The smallest volume that is still FAT16 (4085 clusters), checked for the half-size second LUN at build time
+#define MSC_LUN_MIN_BLOCK_NUM (DISK_DATA_LBA + 4085 * DISK_SECTORS_PER_CLUSTER)
+
+typedef struct
+{
+  char const *product;  // SCSI inquiry product ID, up to 16 characters
+  char label[12];       // volume label, 11 characters padded with spaces
+  uint32_t serial;      // volume serial number
+  uint32_t block_count; // size of the volume, MSC_LUN_MIN_BLOCK_NUM to DISK_BLOCK_NUM sectors
+  uint16_t default_row; // extraction plan until a CONFIG.TXT is saved
+  uint16_t default_col;
+} msc_lun_t;
+
+extern msc_lun_t const msc_luns[MSC_LUN_MAX];
+
+// Number of data clusters, the last cluster is msc_lun_cluster_count(lun) + 1
+static inline uint32_t msc_lun_cluster_count(uint8_t lun)
+{
+  return (msc_luns[lun].block_count - DISK_DATA_LBA) / DISK_SECTORS_PER_CLUSTER;
+}
+
+// Patch the sectors read by the host with the LUN's size, serial number and label, unless the host wrote them
+void msc_lun_read(uint8_t lun, uint32_t lba, uint8_t *buffer, uint32_t bufsize);
+
+#endif /* MSC_LUN_H_ */
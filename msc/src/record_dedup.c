@@ -0,0 +1,48 @@
+#include "record_dedup.h"
+
+typedef struct
+{
+  uint32_t hash;
+  uint32_t time_ms;
+} dedup_entry_t;
+
+static dedup_entry_t ring[DEDUP_RING_SIZE];
+static uint32_t ring_next = 0;
+static uint32_t ring_count = 0;
+
+uint32_t dedup_crc32(uint32_t crc, uint8_t const *data, uint32_t len)
+{
+  // Half-byte table: 64 bytes of flash instead of 1 KB, fast enough for a few short fields per file
+  static const uint32_t table[16] = {
+      0x00000000, 0x1db71064, 0x3b6e20c8, 0x26d930ac, 0x76dc4190, 0x6b6b51f4, 0x4db26158, 0x5005713c,
+      0xedb88320, 0xf00f9344, 0xd6d6a3e8, 0xcb61b38c, 0x9b64c2b0, 0x86d3d2d4, 0xa00ae278, 0xbdbdf21c};
+
+  crc = ~crc;
+  for (uint32_t i = 0; i < len; i++)
+  {
+    crc ^= data[i];
+    crc = (crc >> 4) ^ table[crc & 0x0f];
+    crc = (crc >> 4) ^ table[crc & 0x0f];
+  }
+  return ~crc;
+}
+
+bool dedup_is_duplicate(uint32_t hash, uint32_t now_ms)
+{
+  for (uint32_t i = 0; i < ring_count; i++)
+  {
+    if (ring[i].hash == hash && now_ms - ring[i].time_ms < DEDUP_WINDOW_MS)
+    {
+      return true;
+    }
+  }
+
+  ring[ring_next].hash = hash;
+  ring[ring_next].time_ms = now_ms;
+  ring_next = (ring_next + 1) % DEDUP_RING_SIZE;
+  if (ring_count < DEDUP_RING_SIZE)
+  {
+    ring_count++;
+  }
+  return false;
+}
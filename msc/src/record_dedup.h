@@ -0,0 +1,26 @@
+#ifndef RECORD_DEDUP_H_
+#define RECORD_DEDUP_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Duplicate reading suppression
+// The instrument can rewrite a file it has already saved, which would type the same reading into the PC twice.
+// A CRC32 of each line sent, seeded with the LUN, file name and row it comes from, is compared against a small ring
+// of recently sent hashes, so the same value read from another file or row is still typed.
+
+#ifndef DEDUP_WINDOW_MS
+#define DEDUP_WINDOW_MS 10000 // a record set seen again within this time is a duplicate
+#endif
+
+#ifndef DEDUP_RING_SIZE
+#define DEDUP_RING_SIZE 8
+#endif
+
+// Update a CRC32 (IEEE 802.3) with more data. Start with crc = 0.
+uint32_t dedup_crc32(uint32_t crc, uint8_t const *data, uint32_t len);
+
+// Returns true if the hash was seen within the window. Otherwise the hash is remembered and false is returned.
+bool dedup_is_duplicate(uint32_t hash, uint32_t now_ms);
+
+#endif /* RECORD_DEDUP_H_ */
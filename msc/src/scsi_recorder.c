@@ -0,0 +1,183 @@
+#include <string.h>
+
+#include "pico/stdlib.h"
+#include "hardware/uart.h"
+#include "scsi_recorder.h"
+#include "record_dedup.h"
+#include "sched.h"
+#include "hot_path.h"
+
+#if SCSI_RECORD
+
+#define RECORD_MAX_SIZE (SCSI_RECORD_HEADER_SIZE + SCSI_RECORD_MAX_PAYLOAD + 4)
+#define FRAME_MAX_SIZE (RECORD_MAX_SIZE + RECORD_MAX_SIZE / 254 + 3) // COBS overhead and the two delimiters
+
+static uint8_t ring[SCSI_RECORD_RING_SIZE];
+static uint32_t ring_head = 0; // free running, the ring index is the position modulo the size
+static uint32_t ring_tail = 0;
+static uint32_t dropped = 0; // records lost since the last SCSI_RECORD_DROPPED record
+static uint16_t seq = 0;
+static int drain_task_id = -1;
+
+static void HOT_FUNC(put_u16)(uint8_t *p, uint16_t v)
+{
+  p[0] = (uint8_t)v;
+  p[1] = (uint8_t)(v >> 8);
+}
+
+static void HOT_FUNC(put_u32)(uint8_t *p, uint32_t v)
+{
+  p[0] = (uint8_t)v;
+  p[1] = (uint8_t)(v >> 8);
+  p[2] = (uint8_t)(v >> 16);
+  p[3] = (uint8_t)(v >> 24);
+}
+
+static uint32_t get_u32(uint8_t const *p)
+{
+  return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void HOT_FUNC(ring_write)(uint8_t const *data, uint32_t len)
+{
+  uint32_t pos = ring_head % SCSI_RECORD_RING_SIZE;
+  uint32_t first = len < SCSI_RECORD_RING_SIZE - pos ? len : SCSI_RECORD_RING_SIZE - pos;
+  memcpy(&ring[pos], data, first);
+  memcpy(ring, data + first, len - first);
+  ring_head += len;
+}
+
+static void ring_read(uint8_t *data, uint32_t len)
+{
+  uint32_t pos = ring_tail % SCSI_RECORD_RING_SIZE;
+  uint32_t first = len < SCSI_RECORD_RING_SIZE - pos ? len : SCSI_RECORD_RING_SIZE - pos;
+  memcpy(data, &ring[pos], first);
+  memcpy(data + first, ring, len - first);
+  ring_tail += len;
+}
+
+static void HOT_FUNC(write_header)(scsi_record_type_t type, uint8_t lun, uint32_t lba, uint32_t len)
+{
+  uint8_t header[SCSI_RECORD_HEADER_SIZE];
+  header[0] = (uint8_t)type;
+  header[1] = lun;
+  put_u16(&header[2], seq++);
+  put_u32(&header[4], time_us_32());
+  put_u32(&header[8], lba);
+  put_u32(&header[12], len);
+  ring_write(header, sizeof(header));
+}
+
+// Record the records dropped since the last time, so the replayer knows the records that follow don't follow on
+static bool HOT_FUNC(write_dropped)(uint32_t space)
+{
+  if (space < SCSI_RECORD_HEADER_SIZE)
+  {
+    return false;
+  }
+  write_header(SCSI_RECORD_DROPPED, 0, dropped, 0);
+  dropped = 0;
+  return true;
+}
+
+// Append a record, or count it as dropped if the ring is full
+static void HOT_FUNC(record)(scsi_record_type_t type, uint8_t lun, uint32_t lba, uint8_t const *payload, uint32_t len)
+{
+  uint32_t space = SCSI_RECORD_RING_SIZE - (ring_head - ring_tail);
+  uint32_t needed = SCSI_RECORD_HEADER_SIZE + len + (dropped > 0 ? SCSI_RECORD_HEADER_SIZE : 0);
+  if (space < needed)
+  {
+    dropped++;
+    seq++;
+    return;
+  }
+  if (dropped > 0)
+  {
+    write_dropped(space);
+  }
+  write_header(type, lun, lba, len);
+  ring_write(payload, len);
+  sched_wake(drain_task_id);
+}
+
+void HOT_FUNC(scsi_record_transfer)(scsi_record_type_t type, uint8_t lun, uint32_t lba, uint8_t const *data,
+                                    uint32_t len)
+{
+  record(type, lun, lba, data, len < SCSI_RECORD_MAX_PAYLOAD ? len : SCSI_RECORD_MAX_PAYLOAD);
+}
+
+void HOT_FUNC(scsi_record_command)(uint8_t lun, uint8_t const cdb[SCSI_RECORD_CDB_SIZE])
+{
+  record(SCSI_RECORD_COMMAND, lun, 0, cdb, SCSI_RECORD_CDB_SIZE);
+}
+
+// Consistent overhead byte stuffing: the output has no 0x00 byte, and is at most one byte longer per 254
+static uint32_t cobs_encode(uint8_t const *in, uint32_t len, uint8_t *out)
+{
+  uint32_t code_pos = 0;
+  uint32_t o = 1;
+  uint8_t code = 1;
+  for (uint32_t i = 0; i < len; i++)
+  {
+    if (in[i] != 0)
+    {
+      out[o++] = in[i];
+      code++;
+    }
+    if (in[i] == 0 || code == 0xff)
+    {
+      out[code_pos] = code;
+      code_pos = o++;
+      code = 1;
+    }
+  }
+  out[code_pos] = code;
+  return o;
+}
+
+// Send what the UART TX FIFO takes, a record at a time, so the main loop never waits for the UART. A debug log line
+// printed while a frame is going out lands inside it, and the replayer drops that frame by its CRC.
+static uint32_t drain_task(void)
+{
+  static uint8_t rec[RECORD_MAX_SIZE];
+  static uint8_t frame[FRAME_MAX_SIZE];
+  static uint32_t frame_len = 0;
+  static uint32_t frame_pos = 0; // bytes of the frame sent so far
+
+  if (frame_pos == frame_len)
+  {
+    if (ring_head == ring_tail && !(dropped > 0 && write_dropped(SCSI_RECORD_RING_SIZE)))
+    {
+      return SCHED_IDLE; // woken by the next record
+    }
+
+    ring_read(rec, SCSI_RECORD_HEADER_SIZE);
+    uint32_t len = get_u32(&rec[12]);
+    ring_read(&rec[SCSI_RECORD_HEADER_SIZE], len);
+    len += SCSI_RECORD_HEADER_SIZE;
+    put_u32(&rec[len], dedup_crc32(0, rec, len));
+    len += 4;
+
+    frame[0] = 0;
+    frame_len = 1 + cobs_encode(rec, len, &frame[1]);
+    frame[frame_len++] = 0;
+    frame_pos = 0;
+  }
+
+  while (frame_pos < frame_len && uart_is_writable(uart_default))
+  {
+    uart_putc_raw(uart_default, (char)frame[frame_pos++]);
+  }
+  if (frame_pos < frame_len)
+  {
+    return 1; // the FIFO is full, back once it has drained
+  }
+  return ring_head == ring_tail && dropped == 0 ? SCHED_IDLE : 0;
+}
+
+void scsi_recorder_init(void)
+{
+  drain_task_id = sched_add("record", drain_task);
+}
+
+#endif
@@ -0,0 +1,80 @@
+#ifndef SCSI_RECORDER_H_
+#define SCSI_RECORDER_H_
+
+#include <stdint.h>
+
+// SCSI transaction recorder
+// With SCSI_RECORD=1, every SCSI command the host sends is appended to a RAM ring: READ10 and WRITE10 with their LBA
+// and the sectors as they went over USB, and the other commands with their CDB. Appending only copies into the ring,
+// so a callback never waits for the UART. When the ring is full, records are dropped and counted instead.
+// A task drains the ring to the debug UART, one frame per record, as fast as the TX FIFO takes it.
+// host/src/scsi_replay.c decodes a capture of the debug UART and replays it through the firmware's file capture and
+// CSV extraction.
+//
+// Frame: COBS encoded record followed by a 0x00 byte, so frames can be found between the debug log lines
+// Record, little endian:
+//   u8  type     SCSI_RECORD_READ10, SCSI_RECORD_WRITE10, SCSI_RECORD_COMMAND or SCSI_RECORD_DROPPED
+//   u8  lun
+//   u16 seq      counts every record, including the dropped ones
+//   u32 time_us  time_us_32() when the command was received
+//   u32 lba      LBA of a READ10 or WRITE10, records lost for SCSI_RECORD_DROPPED
+//   u32 length   bytes of the payload
+//   payload      the sectors, or the 16 byte CDB
+//   u32 crc      dedup_crc32() of everything before it
+
+#ifndef SCSI_RECORD
+#define SCSI_RECORD 0 // 1: record the SCSI traffic. Raise PICO_DEFAULT_UART_BAUD_RATE to keep up with it.
+#endif
+
+#ifndef SCSI_RECORD_RING_SIZE
+#define SCSI_RECORD_RING_SIZE (64 * 1024)
+#endif
+
+#define SCSI_RECORD_HEADER_SIZE 16
+#define SCSI_RECORD_CDB_SIZE 16
+#define SCSI_RECORD_MAX_PAYLOAD 4096 // longer transfers are recorded up to this size
+
+typedef enum
+{
+  SCSI_RECORD_READ10 = 'R',
+  SCSI_RECORD_WRITE10 = 'W',
+  SCSI_RECORD_COMMAND = 'C',
+  SCSI_RECORD_DROPPED = 'D',
+} scsi_record_type_t;
+
+#if SCSI_RECORD
+
+// Add the task that drains the ring
+void scsi_recorder_init(void);
+
+// Record a READ10 or WRITE10 and its data
+void scsi_record_transfer(scsi_record_type_t type, uint8_t lun, uint32_t lba, uint8_t const *data, uint32_t len);
+
+// Record any other command
+void scsi_record_command(uint8_t lun, uint8_t const cdb[SCSI_RECORD_CDB_SIZE]);
+
+#else
+
+static inline void scsi_recorder_init(void)
+{
+}
+
+static inline void scsi_record_transfer(scsi_record_type_t type, uint8_t lun, uint32_t lba, uint8_t const *data,
+                                        uint32_t len)
+{
+  (void)type;
+  (void)lun;
+  (void)lba;
+  (void)data;
+  (void)len;
+}
+
+static inline void scsi_record_command(uint8_t lun, uint8_t const cdb[SCSI_RECORD_CDB_SIZE])
+{
+  (void)lun;
+  (void)cdb;
+}
+
+#endif
+
+#endif /* SCSI_RECORDER_H_ */